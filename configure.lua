@@ -27,13 +27,17 @@ return function(build)
 	end
 
 	local fs = build:fs()
+	local lib_files = {}
 	for i, p in pairs(fs:rglob("src/lib/configure", "*.lua"))
 	do
-		local target = fs:copy(
+		table.insert(lib_files, {
 			p,
 			"share/configure/lib/configure" /
 				p:relative_path(build:project_directory() / "src/lib/configure")
-		)
+		})
+	end
+	for i, target in ipairs(fs:copy_files(lib_files))
+	do
 		target:set_property("install", true)
 	end
 
@@ -1,9 +1,13 @@
 #include "Application.hpp"
 
 #include "Build.hpp"
+#include "Daemon.hpp"
 #include "Filesystem.hpp"
+#include "Generator.hpp"
+#include "Manifest.hpp"
 #include "Plugin.hpp"
 #include "Process.hpp"
+#include "StatCache.hpp"
 #include "bind.hpp"
 #include "commands.hpp"
 #include "generators.hpp"
@@ -15,10 +19,15 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
+#include <boost/scope_exit.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <iostream>
 #include <map>
+#include <thread>
 
 namespace fs = boost::filesystem;
 
@@ -49,6 +58,26 @@ namespace configure {
 
 	}
 
+	struct Application::Report
+	{
+		path_t                   directory;
+		std::string              status;
+		std::vector<std::string> build_command;
+		std::exception_ptr       error;
+		long                     duration;
+		// Share of the job limit given to the independent projects.
+		unsigned int             jobs;
+
+		Report(path_t directory)
+			: directory(std::move(directory))
+			, status()
+			, build_command()
+			, error()
+			, duration(0)
+			, jobs(0)
+		{}
+	};
+
 	struct Application::Impl
 	{
 		std::unique_ptr<lua::State>        _lua;
@@ -70,6 +99,10 @@ namespace configure {
 		std::string                        print_var;
 		bool                               clear_properties;
 		bool                               clear_variables;
+		bool                               force;
+		unsigned int                       jobs;
+		bool                               daemon;
+		path_t                             configure_path;
 		Impl(std::vector<std::string> args)
 			: program_name(args.at(0))
 			, args(std::move(args))
@@ -89,6 +122,10 @@ namespace configure {
 			, print_var()
 			, clear_properties(false)
 			, clear_variables(false)
+			, force(false)
+			, jobs(0)
+			, daemon(false)
+			, configure_path()
 		{ this->args.erase(this->args.begin()); }
 
 		void add_plugin(std::string const& arg)
@@ -113,23 +150,63 @@ namespace configure {
 		}
 
 	public:
+		// Whether the previous configuration can be reused when none of its
+		// inputs changed.
+		bool can_reuse_configuration() const
+		{
+			return !force && !clear_properties && !clear_variables &&
+			       plugins.empty();
+		}
+
+		// Whether the build graph or the environ is needed even when the
+		// build files are up to date.
+		bool needs_build_instance() const
+		{
+			return dump_graph || dump_options || dump_env || dump_targets ||
+			       !print_var.empty() ||
+			       build_variables.find("GENERATOR") != build_variables.end();
+		}
+
 		lua::State& lua()
 		{
 			if (_lua == nullptr)
-			{
-				fs::path package = this->library_directory() / "?.lua";
-				_lua.reset(new lua::State);
-				bind(*_lua);
-				_lua->global("configure_library_dir", package.string());
-				_lua->load(
-					"require 'package'\n"
-					"package.path = configure_library_dir\n"
-				);
-				_lua->forbid_globals();
-			}
+				_lua = this->new_lua_state();
 			return *_lua;
 		}
 
+		std::unique_ptr<lua::State> new_lua_state() const
+		{
+			fs::path package = this->library_directory() / "?.lua";
+			return configure::new_lua_state(package.string());
+		}
+
+		// Whether a daemon running in the build directory can answer.
+		bool can_use_daemon() const
+		{
+			return !daemon && build_directories.size() == 1 && !build_mode &&
+			       build_variables.empty() && can_reuse_configuration() &&
+			       !needs_build_instance();
+		}
+
+		// Maximum number of configurations running at the same time.
+		unsigned int job_limit() const
+		{
+			if (jobs != 0)
+				return jobs;
+			return std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		// Number of build directories configured at the same time.
+		unsigned int parallel_jobs() const
+		{
+			// Plugins and dumps work on the shared lua state and the
+			// standard output.
+			if (!plugins.empty() || dump_graph || dump_options || dump_env ||
+			    dump_targets || !print_var.empty())
+				return 1;
+			return job_limit();
+		}
+
 	private:
 		boost::filesystem::path mutable _library_directory;
 
@@ -210,76 +287,296 @@ namespace configure {
 		}
 		log::debug("Current directory:", _this->current_directory);
 		log::debug("Program name:", _this->program_name);
+		BOOST_SCOPE_EXIT(void) {
+			auto& cache = StatCache::instance();
+			log::debug("Stat cache:", cache.hits(), "hits,", cache.misses(), "misses");
+		} BOOST_SCOPE_EXIT_END
 		if (_this->build_directories.empty())
 			throw std::runtime_error("No build directory specified");
 
 		fs::path project_file = Build::find_project_file(_this->project_directory);
-		auto configure_path = *Filesystem::which(_this->program_name.string());
+		_this->configure_path = *Filesystem::which(_this->program_name.string());
+
+		if (_this->daemon)
+		{
+			if (_this->build_directories.size() != 1)
+				CONFIGURE_THROW(
+					error::InvalidArgument("The daemon mode requires one build directory")
+				);
+			auto const& directory = _this->build_directories[0];
+			Daemon daemon(directory, [&] {
+				// A new lua state reloads the modules that changed.
+				Report report(directory);
+				report.jobs = _this->job_limit();
+				auto lua = _this->new_lua_state();
+				this->_configure(*lua, report);
+				return report.status;
+			});
+			daemon.run();
+			return;
+		}
+		if (_this->can_use_daemon())
+		{
+			auto const& directory = _this->build_directories[0];
+			if (auto status = Daemon::request(
+			        directory, "configure",
+			        {_this->project_directory.string()}))
+			{
+				log::status("Build files are", *status, "in", directory, "(daemon)");
+				return;
+			}
+		}
+
+		std::vector<Report> reports;
 		for (auto const& directory: _this->build_directories)
+			reports.push_back(Report{directory});
+
+		unsigned int jobs = std::min<size_t>(_this->parallel_jobs(), reports.size());
+		for (auto& report: reports)
+			report.jobs = std::max(1u, _this->job_limit() / std::max(1u, jobs));
+		if (jobs <= 1)
+		{
+			for (auto& report: reports)
+			{
+				this->_configure(_this->lua(), report);
+				this->_build(report);
+			}
+			return;
+		}
+
+		// Build directories do not share anything, each one is configured
+		// in its own lua state.
+		log::debug("Configuring", reports.size(), "build directories with",
+		           jobs, "jobs");
+		// Lazily resolved, the workers must only read them.
+		_this->library_directory();
+		_this->plugins_directory();
+		std::atomic<size_t> next(0);
+		auto worker = [&] {
+			for (size_t i = next++; i < reports.size(); i = next++)
+			{
+				auto& report = reports[i];
+				auto start = std::chrono::steady_clock::now();
+				try {
+					auto lua = _this->new_lua_state();
+					this->_configure(*lua, report);
+				} catch (...) {
+					report.error = std::current_exception();
+				}
+				report.duration = std::chrono::duration_cast<
+					std::chrono::milliseconds
+				>(std::chrono::steady_clock::now() - start).count();
+			}
+		};
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < jobs; ++i)
+			threads.emplace_back(worker);
+		worker();
+		for (auto& thread: threads)
+			thread.join();
+
+		log::status("Configured", reports.size(), "build directories:");
+		for (auto& report: reports)
+		{
+			if (report.error)
+				log::error("  ", report.directory, "failed:",
+				           error_string(report.error));
+			else
+				log::status("  ", report.directory, report.status, "in",
+				            std::to_string(report.duration) + "ms");
+		}
+		for (auto& report: reports)
+			if (report.error)
+				std::rethrow_exception(report.error);
+		for (auto& report: reports)
+			this->_build(report);
+	}
+
+	void Application::_configure(lua::State& lua, Report& report) const
+	{
+		auto const& directory = report.directory;
+
+		// The generator is not an input of the configuration, switching to
+		// another one only requires the graph snapshot.
+		auto arguments = _this->build_variables;
+		arguments.erase("GENERATOR");
+
+		auto manifest_path = directory / ".build" / "manifest";
+		auto graph_path = directory / ".build" / "graph";
+		Manifest previous;
+		if (fs::is_regular_file(manifest_path))
+		{
+			try { previous.load(manifest_path); }
+			catch (...) {
+				log::warning("Ignoring invalid manifest", manifest_path, ":",
+				             error_string());
+				previous.clear();
+			}
+		}
+
+		bool replay = false;
+		if (_this->can_reuse_configuration() &&
+		    fs::is_regular_file(graph_path))
+		{
+			if (auto change = previous.find_change(_this->project_directory,
+			                                       arguments))
+				log::verbose("Configuring", directory, "because", *change);
+			else
+				replay = true;
+		}
+
+		if (replay && !_this->needs_build_instance() && previous.is_up_to_date())
+		{
+			log::status("Build files are up to date in", directory);
+			report.status = "up to date";
+			if (_this->build_mode)
+			{
+				Build build(_this->configure_path, lua, directory);
+				report.build_command =
+					this->_generator(build)->build_command(_this->build_target);
+			}
+			return;
+		}
+
+		if (!replay)
+		{
+			// Forget the previous inputs, the manifest is saved again
+			// only when the build files are successfully generated.
+			boost::system::error_code ec;
+			fs::remove(manifest_path, ec);
+			fs::remove(graph_path, ec);
+		}
+
+		Build build(_this->configure_path, lua, directory, _this->build_variables);
+		build.jobs(report.jobs);
+		if (replay)
+		{
+			log::verbose("Reusing the configuration graph of", directory);
+			build.load_graph(graph_path);
+			build.manifest() = previous;
+		}
+		else
 		{
-			Build build(configure_path, _this->lua(), directory, _this->build_variables);
 			if (_this->clear_properties)
 				build.clear_properties();
 			if (_this->clear_variables)
 				build.env().clear();
 
+			// Arguments given in previous runs are stored in the environ,
+			// they are still part of the configuration.
+			std::map<std::string, std::string> all_arguments;
+			if (!_this->clear_variables)
+				all_arguments = previous.arguments();
+			for (auto& pair: arguments)
+				all_arguments[pair.first] = pair.second;
+			build.manifest().project_directory(_this->project_directory);
+			build.manifest().arguments(all_arguments);
+			build.manifest().add_file(_this->configure_path);
+			// Scripts are loaded from that directory.
+			char const* library_dir = ::getenv("CONFIGURE_LIBRARY_DIR");
+			build.manifest().add_variable(
+				"CONFIGURE_LIBRARY_DIR",
+				library_dir != nullptr ?
+					boost::optional<std::string>(library_dir) : boost::none
+			);
+
 			for (auto& plugin: _this->plugins)
 			{
 				log::debug("Initialize plugin", plugin.name());
 				plugin.initialize(build);
 			}
 			build.configure(_this->project_directory);
-			if (_this->dump_graph)
-				build.dump_graphviz(std::cout);
-			if (!_this->print_var.empty())
-			{
-				if (!build.env().has(_this->print_var))
-					CONFIGURE_THROW(error::InvalidKey(_this->print_var));
-				std::cout << build.env().as_string(_this->print_var) << std::endl;
-				continue;
-			}
+		}
+		if (_this->dump_graph)
+			build.dump_graphviz(std::cout);
+		if (!_this->print_var.empty())
+		{
+			if (!build.env().has(_this->print_var))
+				CONFIGURE_THROW(error::InvalidKey(_this->print_var));
+			std::cout << build.env().as_string(_this->print_var) << std::endl;
+			report.status = "configured";
+			return;
+		}
+		if (!replay)
+		{
 			for (auto& plugin: _this->plugins)
 			{
 				log::debug("Finalize plugin", plugin.name());
 				plugin.finalize(build);
 			}
-			log::debug("Generating the build files in", build.directory());
-			auto generator = this->_generator(build);
-			assert(generator != nullptr);
-			generator->prepare();
-			generator->generate();
-			log::status("Build files generated successfully in",
-						build.directory(), "(", generator->name(), ")");
-			if (_this->dump_options)
-			{
-				std::cout << "Available options:\n";
-				build.dump_options(std::cout);
-			}
-			if (_this->dump_env)
-			{
-				std::cout << "Environment variables:\n";
-				build.dump_env(std::cout);
-			}
-			if (_this->dump_targets)
+			if (_this->plugins.empty())
 			{
-				std::cout << "Build targets:\n";
-				build.dump_targets(std::cout);
+				try { build.save_graph(graph_path); }
+				catch (...) {
+					log::warning("Couldn't save the build graph in",
+					             graph_path, ":", error_string());
+					boost::system::error_code ec;
+					fs::remove(graph_path, ec);
+				}
 			}
-			if (_this->build_mode)
+		}
+		auto generator = this->_generator(build);
+		assert(generator != nullptr);
+		bool up_to_date = replay;
+		for (auto& file: generator->build_files())
+			up_to_date = up_to_date && previous.is_up_to_date(file);
+		if (!up_to_date || _this->dump_targets)
+			generator->prepare();
+		if (up_to_date)
+		{
+			log::status("Build files are up to date in", build.directory(),
+			            "(", generator->name(), ")");
+			report.status = "up to date";
+		}
+		else
+		{
+			log::debug("Generating the build files in", build.directory());
+			generator->generate();
+			for (auto& file: generator->build_files())
+				build.manifest().add_output(file);
+			if (_this->plugins.empty())
 			{
-				log::status("Starting build in", build.directory());
-				auto cmd = generator->build_command(_this->build_target);
-				int res = Process::call(cmd);
-				if (res != 0)
-					CONFIGURE_THROW(
-						error::BuildError("Build failed with exit code " + std::to_string(res))
-						<< error::path(build.directory())
-						<< error::command(cmd)
-					);
+				try { build.manifest().save(manifest_path); }
+				catch (...) {
+					log::warning("Couldn't save the manifest in", manifest_path,
+					             ":", error_string());
+				}
 			}
+			log::status("Build files generated successfully in",
+			            build.directory(), "(", generator->name(), ")");
+			report.status = replay ? "regenerated" : "configured";
 		}
+		if (_this->dump_options)
+		{
+			std::cout << "Available options:\n";
+			build.dump_options(std::cout);
+		}
+		if (_this->dump_env)
+		{
+			std::cout << "Environment variables:\n";
+			build.dump_env(std::cout);
+		}
+		if (_this->dump_targets)
+		{
+			std::cout << "Build targets:\n";
+			build.dump_targets(std::cout);
+		}
+		if (_this->build_mode)
+			report.build_command = generator->build_command(_this->build_target);
+	}
 
-
+	void Application::_build(Report const& report) const
+	{
+		if (report.build_command.empty())
+			return;
+		log::status("Starting build in", report.directory);
+		int res = Process::call(report.build_command);
+		if (res != 0)
+			CONFIGURE_THROW(
+				error::BuildError("Build failed with exit code " + std::to_string(res))
+				<< error::path(report.directory)
+				<< error::command(report.build_command)
+			);
 	}
 
 	fs::path const& Application::program_name() const
@@ -338,9 +635,15 @@ namespace configure {
 			<< "  -d, --debug" << "               "
 			<< "Enable debug output\n"
 
+			<< "  --daemon" << "                  "
+			<< "Keep the build directory configured in the background\n"
+
 			<< "  -E, --execute" << "             "
 			<< "Execute a builtin command\n"
 
+			<< "  -f, --force" << "               "
+			<< "Configure even if nothing changed since the last run\n"
+
 			<< "  --env" << "                     "
 			<< "Dump all environment variables\n"
 
@@ -350,6 +653,9 @@ namespace configure {
 			<< "  --graph" << "                   "
 			<< "Dump the build graph\n"
 
+			<< "  -j, --jobs N" << "              "
+			<< "Configure up to N build directories at the same time\n"
+
 			<< "  -h, --help" << "                "
 			<< "Show this help and exit\n"
 
@@ -417,6 +723,7 @@ namespace configure {
 			builtin_command,
 			print_var,
 			plugin,
+			jobs,
 			other
 		};
 		NextArg next_arg = NextArg::other;
@@ -462,6 +769,16 @@ namespace configure {
 				next_arg = NextArg::other;
 				log::level() = log::Level::error;
 			}
+			else if (next_arg == NextArg::jobs)
+			{
+				try { _this->jobs = std::stoul(arg); }
+				catch (std::exception const&) {
+					CONFIGURE_THROW(
+						error::InvalidArgument("Invalid number of jobs '" + arg + "'")
+					);
+				}
+				next_arg = NextArg::other;
+			}
 			else if (next_arg == NextArg::builtin_command)
 				_this->builtin_command_args.push_back(arg);
 			else if (arg == "--project")
@@ -492,6 +809,12 @@ namespace configure {
 				_this->build_mode = true;
 			else if (arg == "-E" || arg == "--execute")
 				next_arg = NextArg::builtin_command;
+			else if (arg == "-j" || arg == "--jobs")
+				next_arg = NextArg::jobs;
+			else if (arg == "--daemon")
+				_this->daemon = true;
+			else if (arg == "-f" || arg == "--force")
+				_this->force = true;
 			else if (arg == "-c" || arg == "--clear")
 				_this->clear_properties = true;
 			else if (arg == "-C" || arg == "--clear-all")
@@ -510,7 +833,11 @@ namespace configure {
 			         !fs::exists(arg) ||
 			         (fs::is_directory(arg) && fs::is_empty(arg)))
 			{
-				_this->build_directories.push_back(fs::absolute(arg));
+				// Generated files call configure again with a relative
+				// build directory.
+				_this->build_directories.push_back(
+					fs::exists(arg) ? fs::canonical(arg) : fs::absolute(arg)
+				);
 			}
 			else
 			{
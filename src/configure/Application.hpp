@@ -1,6 +1,7 @@
 #pragma once
 
 #include "fwd.hpp"
+#include "lua/fwd.hpp"
 
 #include <boost/filesystem/path.hpp>
 
@@ -17,6 +18,7 @@ namespace configure {
 	private:
 		struct Impl;
 		std::unique_ptr<Impl> _this;
+		struct Report;
 
 	public:
 		Application(int ac, char** av);
@@ -39,6 +41,8 @@ namespace configure {
 
 	private:
 		std::unique_ptr<Generator> _generator(Build& build) const;
+		void _configure(lua::State& lua, Report& report) const;
+		void _build(Report const& report) const;
 		void _parse_args();
 	};
 
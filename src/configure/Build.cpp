@@ -1,6 +1,7 @@
 #include "Build.hpp"
 
 #include "BuildGraph.hpp"
+#include "bind.hpp"
 #include "Command.hpp"
 #include "DependencyLink.hpp"
 #include "Environ.hpp"
@@ -8,9 +9,12 @@
 #include "Filesystem.hpp"
 #include "log.hpp"
 #include "lua/State.hpp"
+#include "Manifest.hpp"
 #include "Platform.hpp"
 #include "Rule.hpp"
 #include "quote.hpp"
+#include "ShellCommand.hpp"
+#include "StatCache.hpp"
 #include "utils/path.hpp"
 #include "PropertyMap.hpp"
 #include "utils/path.hpp"
@@ -24,17 +28,45 @@
 #include <boost/optional.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
 #include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/variant/apply_visitor.hpp>
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <thread>
 
 namespace fs = boost::filesystem;
 
 namespace configure {
 
+	namespace {
+
+		// Replaces os.getenv while configuring, the variables read are
+		// inputs of the configuration.
+		int recorded_getenv(lua_State* state)
+		{
+			auto& manifest = *static_cast<Manifest*>(
+			    lua_touserdata(state, lua_upvalueindex(1)));
+			char const* name = luaL_checkstring(state, 1);
+			char const* value = ::getenv(name);
+			manifest.add_variable(
+			    name,
+			    value != nullptr ?
+			        boost::optional<std::string>(value) : boost::none
+			);
+			lua_pushstring(state, value); // nil when not set
+			return 1;
+		}
+
+	}
+
 	struct Build::Impl
 	{
 		fs::path                                 configure_program;
@@ -51,15 +83,27 @@ namespace configure {
 		NodePtr                                  root_node;
 		Filesystem                               fs;
 		Environ                                  env;
+		Manifest                                 manifest;
 		fs::path                                 env_path;
 		fs::path                                 properties_path;
 		std::map<std::string, std::string>       options;
 		std::map<std::string, std::string>       build_args;
 		std::unique_ptr<Platform>                host_platform;
 		std::unique_ptr<Platform>                target_platform;
+		std::vector<std::pair<fs::path, fs::path>> independent_projects;
+		unsigned int                             jobs;
+		bool                                     is_sub_build;
 
 		Impl(Build& build, fs::path configure_program, lua::State& lua,
 		     fs::path directory)
+		    : Impl(build, std::move(configure_program), lua,
+		           std::move(directory), nullptr)
+		{}
+
+		// A sub-build reads the properties of its parent, and keeps the ones
+		// it uses in its own map, merged back by its parent.
+		Impl(Build& build, fs::path configure_program, lua::State& lua,
+		     fs::path directory, Impl* parent)
 		    : configure_program(std::move(configure_program))
 		    , root_directory(std::move(directory))
 		    , lua(lua)
@@ -70,16 +114,22 @@ namespace configure {
 		    , file_nodes()
 		    , directory_nodes()
 		    , properties()
-		    , build_graph(properties)
+		    , build_graph(
+		        properties,
+		        parent != nullptr ? &parent->build_graph : nullptr)
 		    , root_node(this->build_graph.add_node<VirtualNode>(""))
 		    , fs(build)
-		    , env()
+		    , env(parent != nullptr ? parent->env : Environ())
+		    , manifest()
 		    , env_path(root_directory / ".build" / "env")
 		    , properties_path(root_directory / ".build" / "properties")
 		    , options()
 		    , build_args()
 		    , host_platform(nullptr)
 		    , target_platform(nullptr)
+		    , independent_projects()
+		    , jobs(0)
+		    , is_sub_build(parent != nullptr)
 		{}
 	};
 
@@ -135,8 +185,20 @@ namespace configure {
 
 	}
 
+	Build::Build(Build& parent, lua::State& lua)
+	    : _this(new Impl(*this, parent._this->configure_program, lua,
+	                     parent._this->root_directory, parent._this.get()))
+	{
+		_this->build_stack.push_back(_this->root_directory);
+		_this->build_stack.push_back(parent.directory());
+		_this->project_stack.push_back(parent.project_directory());
+		_this->build_args = parent._this->build_args;
+	}
+
 	Build::~Build()
 	{
+		if (_this->is_sub_build)
+			return;
 		auto cache = _this->root_directory / ".build";
 		if (fs::is_directory(cache))
 		{
@@ -179,7 +241,7 @@ namespace configure {
 		try {
 			if (!project_directory.is_absolute())
 				CONFIGURE_THROW(error::InvalidProject("Not an absolute path"));
-			if (!fs::is_directory(project_directory))
+			if (!StatCache::instance().is_directory(project_directory))
 				CONFIGURE_THROW(error::InvalidProject("Not a directory"));
 			if (fs::equivalent(project_directory, this->directory()))
 				CONFIGURE_THROW(error::InvalidProject("Same as build directory"));
@@ -191,13 +253,30 @@ namespace configure {
 		_this->build_stack.push_back(_prepare_build_directory(sub_directory));
 		log::status("Configuring project", this->project_directory(), "in", this->directory());
 
-		BOOST_SCOPE_EXIT((&_this)){
+		lua_State* state = _this->lua.ptr();
+		lua_getglobal(state, "os");
+		lua_getfield(state, -1, "getenv");
+		int previous_getenv = luaL_ref(state, LUA_REGISTRYINDEX);
+		lua_pushlightuserdata(state, &_this->manifest);
+		lua_pushcclosure(state, &recorded_getenv, 1);
+		lua_setfield(state, -2, "getenv");
+		lua_pop(state, 1);
+
+		BOOST_SCOPE_EXIT((&_this)(state)(previous_getenv)){
 			_this->project_stack.pop_back();
 			_this->build_stack.pop_back();
+			lua_getglobal(state, "os");
+			lua_rawgeti(state, LUA_REGISTRYINDEX, previous_getenv);
+			lua_setfield(state, -2, "getenv");
+			lua_pop(state, 1);
+			luaL_unref(state, LUA_REGISTRYINDEX, previous_getenv);
 		} BOOST_SCOPE_EXIT_END
 
 		try {
-			_this->lua.load(find_project_file(project_directory), 1);
+			auto project_file = find_project_file(project_directory);
+			_this->manifest.add_file(project_file);
+			auto first_independent = _this->independent_projects.size();
+			_this->lua.load(project_file, 1);
 			if (lua_isnil(_this->lua.ptr(), -1))
 				CONFIGURE_THROW(error::InvalidProject(
 					"No function returned from the configuration script")
@@ -206,6 +285,7 @@ namespace configure {
 			if (has_args)
 				_this->lua.pushvalue(-3);
 			_this->lua.call(has_args ? 2 : 1);
+			_configure_independent_projects(first_independent);
 		} catch (error::Base&) { //XXX insert project stack here
 			//e << error::message(
 			//	"While configuring project " + project_directory.string()
@@ -245,6 +325,9 @@ namespace configure {
 	Environ& Build::env()
 	{ return _this->env; }
 
+	Manifest& Build::manifest()
+	{ return _this->manifest; }
+
 	fs::path const& Build::configure_program() const
 	{ return _this->configure_program; }
 
@@ -365,6 +448,7 @@ namespace configure {
 	fs::path Build::_prepare_build_directory(fs::path const& sub_directory)
 	{
 		fs::create_directories(this->directory() / sub_directory / ".build");
+		StatCache::instance().invalidate(this->directory() / sub_directory);
 		return fs::canonical(this->directory() / sub_directory);
 	}
 
@@ -387,6 +471,115 @@ namespace configure {
 		{
 			log::debug("Creating directory", d);
 			fs::create_directories(d);
+			StatCache::instance().invalidate(d);
+		}
+		_record_lua_modules();
+	}
+
+	void Build::_record_lua_modules()
+	{
+		lua_State* state = _this->lua.ptr();
+		lua_getglobal(state, "package");
+		lua_getfield(state, -1, "searchpath");
+		lua_getfield(state, -2, "path");
+		lua_getfield(state, -3, "loaded");
+		lua_pushnil(state);
+		while (lua_next(state, -2) != 0)
+		{
+			lua_pop(state, 1);
+			if (lua_type(state, -1) != LUA_TSTRING)
+				continue;
+			lua_pushvalue(state, -4); // searchpath
+			lua_pushvalue(state, -2); // module name
+			lua_pushvalue(state, -5); // package.path
+			lua_call(state, 2, 1);
+			if (char const* module = lua_tostring(state, -1))
+				_this->manifest.add_file(module);
+			lua_pop(state, 1);
+		}
+		lua_pop(state, 4);
+	}
+
+	void Build::include_independent(fs::path const& project_directory,
+	                                fs::path const& sub_directory)
+	{
+		_this->independent_projects.emplace_back(project_directory, sub_directory);
+	}
+
+	void Build::_configure_independent_projects(size_t first)
+	{
+		if (_this->independent_projects.size() <= first)
+			return;
+		std::vector<std::pair<fs::path, fs::path>> projects(
+		    _this->independent_projects.begin() + first,
+		    _this->independent_projects.end());
+		_this->independent_projects.resize(first);
+
+		lua_getglobal(_this->lua.ptr(), "package");
+		lua_getfield(_this->lua.ptr(), -1, "path");
+		std::string package_path = lua_tostring(_this->lua.ptr(), -1);
+		lua_pop(_this->lua.ptr(), 2);
+
+		size_t const count = projects.size();
+		std::vector<std::unique_ptr<lua::State>> states(count);
+		std::vector<std::unique_ptr<Build>> builds(count);
+		std::vector<std::exception_ptr> errors(count);
+		size_t jobs = std::min<size_t>(count, this->jobs());
+		std::atomic<size_t> next(0);
+		auto worker = [&] {
+			for (size_t i = next++; i < count; i = next++)
+			{
+				try {
+					states[i] = new_lua_state(package_path);
+					builds[i].reset(new Build(*this, *states[i]));
+					// Nested independent projects share the same limit.
+					builds[i]->jobs(std::max<size_t>(1, this->jobs() / jobs));
+					builds[i]->configure(projects[i].first, projects[i].second);
+					builds[i]->_record_lua_modules();
+				} catch (...) {
+					errors[i] = std::current_exception();
+				}
+			}
+		};
+
+		log::debug("Configuring", count, "independent projects with", jobs, "jobs");
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < jobs; ++i)
+			threads.emplace_back(worker);
+		worker();
+		for (auto& thread: threads)
+			thread.join();
+
+		// Merge in declaration order to keep the graph deterministic.
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (errors[i])
+				std::rethrow_exception(errors[i]);
+			_merge(*builds[i]);
+		}
+	}
+
+	void Build::_merge(Build& other)
+	{
+		std::stringstream graph;
+		other._save_graph(graph);
+		_load_graph(graph);
+		for (auto& key: other._this->env.keys())
+			_this->env.set(key, other._this->env.get(key));
+		// Forget the command line arguments consumed by the sub-build.
+		for (auto it = _this->build_args.begin(); it != _this->build_args.end();)
+		{
+			if (other._this->build_args.count(it->first) == 0)
+				it = _this->build_args.erase(it);
+			else
+				++it;
+		}
+		_this->manifest.merge(other._this->manifest);
+		for (auto& pair: other._this->properties)
+		{
+			auto& properties = _this->properties[pair.first];
+			for (auto& key: pair.second.keys())
+				properties.set(key, pair.second.get(key));
 		}
 	}
 
@@ -403,7 +596,7 @@ namespace configure {
 	fs::path Build::find_project_file(fs::path project_directory)
 	{
 		for (auto&& p: possible_configure_files())
-			if (fs::is_regular_file(project_directory / p))
+			if (StatCache::instance().is_regular_file(project_directory / p))
 				return project_directory / p;
 		throw std::runtime_error("No configuration file found in " + project_directory.string());
 	}
@@ -460,7 +653,8 @@ namespace configure {
 						<< error::path(src)
 				);
 		}
-		if (!fs::is_regular_file(src))
+		_this->manifest.add_path(src);
+		if (!StatCache::instance().is_regular_file(src))
 			CONFIGURE_THROW(error::InvalidSourceNode("File not found")
 				<< error::path(src)
 			);
@@ -551,6 +745,248 @@ namespace configure {
 		return *_this->target_platform;
 	}
 
+	namespace {
+
+		// Bump when the snapshot format changes.
+		unsigned int const graph_snapshot_version = 1;
+
+		enum class ArgKind : int
+		{
+			string,
+			path,
+			node,
+		};
+
+		struct SaveShellArg
+			: boost::static_visitor<>
+		{
+			boost::archive::binary_oarchive& ar;
+
+			SaveShellArg(boost::archive::binary_oarchive& ar) : ar(ar) {}
+
+			void operator ()(std::string const& value)
+			{ ar << ArgKind::string << value; }
+			void operator ()(fs::path const& value)
+			{ ar << ArgKind::path << value; }
+			void operator ()(NodePtr const& value)
+			{ ar << ArgKind::node << value->index; }
+			void operator ()(ShellArgPtr const& value)
+			{
+				CONFIGURE_THROW(
+					error::RuntimeError(
+						"Cannot save the dynamic shell argument " + value->dump())
+				);
+			}
+		};
+
+	}
+
+	void Build::save_graph(fs::path const& path) const
+	{
+		std::ofstream out(path.string(), std::ios::binary);
+		_save_graph(out);
+	}
+
+	void Build::_save_graph(std::ostream& out) const
+	{
+		boost::archive::binary_oarchive ar(out);
+		ar << graph_snapshot_version;
+		ar << _this->configured_projects;
+		ar << _this->options;
+
+		BuildGraph const& bg = _this->build_graph;
+		Graph const& g = bg.graph();
+		size_t node_count = boost::num_vertices(g);
+		ar << node_count;
+		for (Node::index_type i = 0; i < node_count; ++i)
+		{
+			auto& node = bg.node(i);
+			ar << node->kind();
+			if (node->is_virtual())
+				ar << node->name();
+			else
+				ar << node->path();
+		}
+
+		// Commands are shared between the links of a rule.
+		std::unordered_map<Command const*, size_t> commands;
+		size_t link_count = boost::num_edges(g);
+		ar << link_count;
+		for (auto range = boost::edges(g); range.first != range.second; ++range.first)
+		{
+			auto& link = bg.link(*range.first);
+			ar << static_cast<Node::index_type>(boost::source(*range.first, g));
+			ar << static_cast<Node::index_type>(boost::target(*range.first, g));
+			bool has_command = link.has_command();
+			ar << has_command;
+			if (!has_command)
+				continue;
+			auto it = commands.find(&link.command());
+			bool is_new = (it == commands.end());
+			ar << is_new;
+			if (!is_new)
+			{
+				ar << it->second;
+				continue;
+			}
+			size_t id = commands.size();
+			commands[&link.command()] = id;
+			auto& shell_commands = link.command().shell_commands();
+			ar << shell_commands.size();
+			for (auto& shell_command: shell_commands)
+			{
+				ar << shell_command.args().size();
+				SaveShellArg visitor(ar);
+				for (auto& arg: shell_command.args())
+					boost::apply_visitor(visitor, arg);
+				bool has_working_directory = shell_command.has_working_directory();
+				ar << has_working_directory;
+				if (has_working_directory)
+					ar << shell_command.working_directory();
+				bool has_env = shell_command.has_env();
+				ar << has_env;
+				if (has_env)
+					ar << shell_command.env();
+			}
+		}
+	}
+
+	void Build::load_graph(fs::path const& path)
+	{
+		if (!_this->virtual_nodes.empty() || !_this->file_nodes.empty() ||
+		    !_this->directory_nodes.empty())
+			throw std::logic_error("Cannot load a graph in a non empty build");
+		std::ifstream in(path.string(), std::ios::binary);
+		if (!in)
+			CONFIGURE_THROW(
+				error::FileNotFound("Cannot open the graph snapshot")
+					<< error::path(path)
+			);
+		try { _load_graph(in); }
+		catch (error::Base& err) { throw err << error::path(path); }
+	}
+
+	void Build::_load_graph(std::istream& in)
+	{
+		boost::archive::binary_iarchive ar(in);
+		unsigned int version;
+		ar >> version;
+		if (version != graph_snapshot_version)
+			CONFIGURE_THROW(
+				error::InvalidEnviron(
+					"Unsupported graph snapshot version " + std::to_string(version))
+			);
+		std::vector<fs::path> configured_projects;
+		ar >> configured_projects;
+		_this->configured_projects.insert(_this->configured_projects.end(),
+		                                  configured_projects.begin(),
+		                                  configured_projects.end());
+		std::map<std::string, std::string> options;
+		ar >> options;
+		_this->options.insert(options.begin(), options.end());
+
+		size_t node_count;
+		ar >> node_count;
+		std::vector<NodePtr> nodes;
+		nodes.reserve(node_count);
+		for (size_t i = 0; i < node_count; ++i)
+		{
+			Node::Kind kind;
+			ar >> kind;
+			if (kind == Node::virtual_node)
+			{
+				std::string name;
+				ar >> name;
+				if (name.empty())
+					nodes.push_back(_this->root_node);
+				else
+					nodes.push_back(this->virtual_node(name));
+			}
+			else
+			{
+				fs::path p;
+				ar >> p;
+				if (kind == Node::file_node)
+					nodes.push_back(this->file_node(std::move(p)));
+				else
+					nodes.push_back(this->directory_node(std::move(p)));
+			}
+		}
+
+		std::vector<CommandPtr> commands;
+		size_t link_count;
+		ar >> link_count;
+		for (size_t i = 0; i < link_count; ++i)
+		{
+			Node::index_type source, target;
+			ar >> source >> target;
+			auto& link = _this->build_graph.link(*nodes.at(source), *nodes.at(target));
+			bool has_command;
+			ar >> has_command;
+			if (!has_command)
+				continue;
+			bool is_new;
+			ar >> is_new;
+			if (!is_new)
+			{
+				size_t id;
+				ar >> id;
+				link.command(commands.at(id));
+				continue;
+			}
+			size_t shell_command_count;
+			ar >> shell_command_count;
+			std::vector<ShellCommand> shell_commands(shell_command_count);
+			for (auto& shell_command: shell_commands)
+			{
+				size_t arg_count;
+				ar >> arg_count;
+				for (size_t j = 0; j < arg_count; ++j)
+				{
+					ArgKind arg_kind;
+					ar >> arg_kind;
+					if (arg_kind == ArgKind::string)
+					{
+						std::string value;
+						ar >> value;
+						shell_command.append(std::move(value));
+					}
+					else if (arg_kind == ArgKind::path)
+					{
+						fs::path value;
+						ar >> value;
+						shell_command.append(std::move(value));
+					}
+					else
+					{
+						Node::index_type index;
+						ar >> index;
+						shell_command.append(nodes.at(index));
+					}
+				}
+				bool has_working_directory;
+				ar >> has_working_directory;
+				if (has_working_directory)
+				{
+					fs::path dir;
+					ar >> dir;
+					shell_command.working_directory(std::move(dir));
+				}
+				bool has_env;
+				ar >> has_env;
+				if (has_env)
+				{
+					ShellCommand::Environ env;
+					ar >> env;
+					shell_command.env(std::move(env));
+				}
+			}
+			commands.push_back(
+				std::make_shared<Command>(std::move(shell_commands)));
+			link.command(commands.back());
+		}
+	}
+
 	void Build::dump_graphviz(std::ostream& out) const
 	{
 		struct Writer {
@@ -634,6 +1070,16 @@ namespace configure {
 	lua::State& Build::lua_state() const
 	{ return _this->lua; }
 
+	void Build::jobs(unsigned int count)
+	{ _this->jobs = count; }
+
+	unsigned int Build::jobs() const
+	{
+		if (_this->jobs != 0)
+			return _this->jobs;
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
 	void Build::visit_targets(std::function<void(NodePtr&)> const& fn)
 	{
 		// XXX lock file nodes
@@ -60,12 +60,20 @@ namespace configure {
 		// Environ
 		Environ& env();
 
+		// Inputs of the configuration.
+		Manifest& manifest();
+
 		// Path to the configure executable.
 		path_t const& configure_program() const;
 
 		// Lua state in use for the configuration.
 		lua::State& lua_state() const;
 
+		// Maximum number of independent projects configured at the same
+		// time, defaults to the number of cores.
+		void jobs(unsigned int count);
+		unsigned int jobs() const;
+
 		void clear_properties();
 
 	public:
@@ -122,9 +130,34 @@ namespace configure {
 		// The target platform
 		Platform& target();
 
+	private:
+		// Sub-build used to configure an independent project.
+		Build(Build& parent, lua::State& lua);
+		void _configure_independent_projects(size_t first);
+		void _merge(Build& other);
+		void _save_graph(std::ostream& out) const;
+		void _load_graph(std::istream& in);
+
 	private:
 		path_t _prepare_build_directory(path_t const& sub_directory);
 		void _finalize_build_directory();
+		void _record_lua_modules();
+
+	public:
+		// Queue a sub-project that does not depend on the current one. Queued
+		// projects are configured concurrently, each one in its own lua
+		// state, when the current project configuration returns.
+		void include_independent(path_t const& project_directory,
+		                         path_t const& sub_directory = ".");
+
+	public:
+		// Save the build graph, the declared options and the configured
+		// projects in a binary snapshot.
+		void save_graph(path_t const& path) const;
+
+		// Restore a snapshot saved with save_graph() instead of configuring
+		// a project. The build graph must be empty.
+		void load_graph(path_t const& path);
 
 	public:
 		static std::vector<path_t> const& possible_configure_files();
@@ -23,19 +23,22 @@ namespace configure {
 		NodeMap  node_map;
 		LinkMap link_map;
 		FileProperties& properties;
+		BuildGraph const* parent;
 
 	public:
-		Impl(FileProperties& properties)
+		Impl(FileProperties& properties, BuildGraph const* parent)
 			: graph()
 			, index_map(boost::get(boost::vertex_index, graph))
 			, node_map()
 			, link_map()
 			, properties(properties)
+			, parent(parent)
 		{}
 	};
 
-	BuildGraph::BuildGraph(FileProperties& properties)
-		: _this{new Impl(properties)}
+	BuildGraph::BuildGraph(FileProperties& properties,
+	                       BuildGraph const* parent)
+		: _this{new Impl(properties, parent)}
 	{}
 
 	BuildGraph::~BuildGraph()
@@ -92,6 +95,16 @@ namespace configure {
 		//	    error::InvalidNode("Only file node have properties")
 		//			<< error::node(_this->node_map[node.index])
 		//	);
+		auto it = _this->properties.find(node.path());
+		if (it != _this->properties.end())
+			return it->second;
+		for (auto graph = _this->parent; graph != nullptr; graph = graph->_this->parent)
+		{
+			auto parent_it = graph->_this->properties.find(node.path());
+			if (parent_it != graph->_this->properties.end())
+				return _this->properties.emplace(
+					node.path(), parent_it->second).first->second;
+		}
 		return _this->properties[node.path()];
 	}
 
@@ -23,7 +23,10 @@ namespace configure {
 		std::unique_ptr<Impl> _this;
 
 	public:
-		BuildGraph(FileProperties& properties);
+		// Properties missing from `properties` are copied from the `parent`
+		// graph ones, which are only read.
+		BuildGraph(FileProperties& properties,
+		           BuildGraph const* parent = nullptr);
 		~BuildGraph();
 
 	public:
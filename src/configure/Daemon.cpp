@@ -0,0 +1,415 @@
+#include "Daemon.hpp"
+
+#include "Manifest.hpp"
+#include "StatCache.hpp"
+#include "error.hpp"
+#include "log.hpp"
+#include "utils/path.hpp"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+
+#ifdef __linux__
+# include <poll.h>
+# include <sys/inotify.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <unistd.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <set>
+
+namespace fs = boost::filesystem;
+
+namespace configure {
+
+#ifdef __linux__
+	namespace {
+
+		void send_all(int fd, std::string const& data)
+		{
+			size_t sent = 0;
+			while (sent < data.size())
+			{
+				auto res = ::send(fd, data.data() + sent, data.size() - sent,
+				                  MSG_NOSIGNAL);
+				if (res < 0)
+				{
+					if (errno == EINTR) continue;
+					CONFIGURE_THROW_SYSTEM_ERROR("send()");
+				}
+				sent += res;
+			}
+		}
+
+		// Read until `delimiter` is found or the peer closes the
+		// connection. An empty delimiter reads everything.
+		std::string recv_until(int fd, std::string const& delimiter)
+		{
+			std::string res;
+			char buffer[256];
+			while (delimiter.empty() || res.find(delimiter) == std::string::npos)
+			{
+				auto size = ::recv(fd, buffer, sizeof(buffer), 0);
+				if (size < 0)
+				{
+					if (errno == EINTR) continue;
+					CONFIGURE_THROW_SYSTEM_ERROR("recv()");
+				}
+				if (size == 0)
+					break;
+				res.append(buffer, size);
+			}
+			return res;
+		}
+
+		struct sockaddr_un socket_address(fs::path const& path)
+		{
+			struct sockaddr_un addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			if (path.string().size() >= sizeof(addr.sun_path))
+				CONFIGURE_THROW(
+					error::InvalidPath("Daemon socket path is too long")
+						<< error::path(path)
+				);
+			std::strcpy(addr.sun_path, path.c_str());
+			return addr;
+		}
+
+		// Returns a connected socket or -1.
+		int connect_to(fs::path const& path)
+		{
+			auto addr = socket_address(path);
+			int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+				CONFIGURE_THROW_SYSTEM_ERROR("socket()");
+			if (::connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+			{
+				::close(fd);
+				return -1;
+			}
+			return fd;
+		}
+
+	}
+#endif
+
+	struct Daemon::Impl
+	{
+		path_t              build_directory;
+		path_t              socket_path;
+		configure_t         configure;
+		int                 server;
+		int                 notify;
+		std::vector<path_t> watched;
+
+		Impl(path_t build_directory, configure_t configure)
+			: build_directory(std::move(build_directory))
+			, socket_path(Daemon::socket_path(this->build_directory))
+			, configure(std::move(configure))
+			, server(-1)
+			, notify(-1)
+			, watched()
+		{}
+
+		~Impl()
+		{
+#ifdef __linux__
+			if (notify != -1)
+				::close(notify);
+			if (server != -1)
+			{
+				::close(server);
+				::unlink(socket_path.c_str());
+			}
+#endif
+		}
+
+#ifdef __linux__
+		void listen()
+		{
+			int fd = connect_to(socket_path);
+			if (fd != -1)
+			{
+				::close(fd);
+				CONFIGURE_THROW(
+					error::RuntimeError("A daemon is already running")
+						<< error::path(build_directory)
+				);
+			}
+			fs::create_directories(socket_path.parent_path());
+			::unlink(socket_path.c_str());
+			auto addr = socket_address(socket_path);
+			server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if (server < 0)
+				CONFIGURE_THROW_SYSTEM_ERROR("socket()");
+			if (::bind(server, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+				CONFIGURE_THROW_SYSTEM_ERROR("bind()");
+			if (::listen(server, 8) != 0)
+				CONFIGURE_THROW_SYSTEM_ERROR("listen()");
+		}
+
+		// Watch the directories recorded in the manifest. The previous
+		// watches are kept when the configuration failed and no manifest
+		// was saved.
+		void watch()
+		{
+			auto manifest_path = build_directory / ".build" / "manifest";
+			if (fs::is_regular_file(manifest_path))
+			{
+				Manifest manifest;
+				try {
+					manifest.load(manifest_path);
+					watched = manifest.input_directories();
+				} catch (...) {
+					log::warning("Couldn't read", manifest_path, ":",
+					             error_string());
+				}
+			}
+			if (notify != -1)
+				::close(notify);
+			notify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (notify < 0)
+				CONFIGURE_THROW_SYSTEM_ERROR("inotify_init1()");
+			for (auto& dir: watched)
+			{
+				// Configuring writes in the build directory.
+				if (utils::starts_with(dir, build_directory))
+					continue;
+				uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY |
+				                IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+				                IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF;
+				if (::inotify_add_watch(notify, dir.c_str(), mask) < 0)
+					log::debug("Cannot watch", dir, ":", std::strerror(errno));
+			}
+			log::debug("Watching", watched.size(), "directories");
+		}
+
+		void drain_events()
+		{
+			char buffer[4096];
+			while (::read(notify, buffer, sizeof(buffer)) > 0)
+			{}
+		}
+#endif
+
+		// Why a configuration made with the environment of the daemon
+		// cannot be used by a client, or none if it can. `args` are the
+		// project directory of the client followed by its environment.
+		boost::optional<std::string>
+		check_client(std::vector<std::string> const& args) const
+		{
+			if (args.empty())
+				return std::string("no project directory given");
+			auto manifest_path = build_directory / ".build" / "manifest";
+			Manifest manifest;
+			try { manifest.load(manifest_path); }
+			catch (...) { return std::string("no valid manifest"); }
+			if (path_t(args[0]) != manifest.project_directory())
+				return std::string("the project directory differs");
+
+			std::map<std::string, std::string> client_environ;
+			for (size_t i = 1; i < args.size(); ++i)
+			{
+				auto pos = args[i].find('=');
+				// The first value wins, explicit arguments come first.
+				if (pos != std::string::npos)
+					client_environ.emplace(args[i].substr(0, pos),
+					                       args[i].substr(pos + 1));
+			}
+			// Programs are looked up in the PATH.
+			std::set<std::string> names{"PATH"};
+			for (auto& pair: manifest.variables())
+				names.insert(pair.first);
+			for (auto& name: names)
+			{
+				auto it = client_environ.find(name);
+				char const* value = std::getenv(name.c_str());
+				if ((it != client_environ.end()) != (value != nullptr) ||
+				    (value != nullptr && it->second != value))
+					return "environment variable " + name + " differs";
+			}
+			return boost::none;
+		}
+
+		// Returns the reply sent to clients. The stat cache is cleared first:
+		// files may have changed outside of the watched directories, like
+		// in the build directory.
+		std::string reconfigure()
+		{
+			std::string reply;
+			StatCache::instance().invalidate();
+			try {
+				reply = "ok " + configure() + "\n";
+			} catch (...) {
+				auto err = error_string();
+				log::error(err);
+				reply = "error\n" + err;
+			}
+#ifdef __linux__
+			this->watch();
+#endif
+			return reply;
+		}
+	};
+
+	Daemon::Daemon(path_t build_directory, configure_t configure)
+		: _this(new Impl(std::move(build_directory), std::move(configure)))
+	{
+#ifdef __linux__
+		_this->listen();
+#else
+		CONFIGURE_THROW(
+			error::PlatformError("The daemon mode is not supported on this platform")
+		);
+#endif
+	}
+
+	Daemon::~Daemon()
+	{}
+
+	void Daemon::run()
+	{
+#ifdef __linux__
+		_this->reconfigure();
+		log::status("Daemon listening on", _this->socket_path);
+		bool pending = false;
+		while (true)
+		{
+			struct pollfd fds[2];
+			fds[0].fd = _this->server;
+			fds[0].events = POLLIN;
+			fds[1].fd = _this->notify;
+			fds[1].events = POLLIN;
+			// Wait for the changes to settle before configuring again.
+			int res = ::poll(fds, 2, pending ? 100 : -1);
+			if (res < 0)
+			{
+				if (errno == EINTR) continue;
+				CONFIGURE_THROW_SYSTEM_ERROR("poll()");
+			}
+			if (res == 0)
+			{
+				log::verbose("Inputs changed, configuring", _this->build_directory);
+				_this->reconfigure();
+				pending = false;
+				continue;
+			}
+			if (fds[1].revents & POLLIN)
+			{
+				_this->drain_events();
+				pending = true;
+			}
+			if (fds[0].revents & POLLIN)
+			{
+				int client = ::accept4(_this->server, nullptr, nullptr, SOCK_CLOEXEC);
+				if (client < 0)
+					continue;
+				bool stop = false;
+				try {
+					// Fields terminated by a NUL, the last one is empty.
+					auto request = recv_until(client, std::string(2, '\0'));
+					std::vector<std::string> args;
+					boost::split(args, request, [] (char c) { return c == '\0'; });
+					while (!args.empty() && args.back().empty())
+						args.pop_back();
+					std::string command;
+					if (!args.empty())
+					{
+						command = args.front();
+						args.erase(args.begin());
+					}
+					log::debug("Daemon request:", command);
+					std::string reply;
+					if (command == "configure")
+					{
+						// The client configures the build directory itself
+						// when the environment differs, checked before
+						// and after the inputs it read are updated.
+						auto refused = _this->check_client(args);
+						if (!refused)
+						{
+							reply = _this->reconfigure();
+							pending = false;
+							refused = _this->check_client(args);
+						}
+						if (refused)
+						{
+							log::verbose("Refusing to configure for a client:", *refused);
+							reply = "refused\n" + *refused;
+						}
+					}
+					else if (command == "stop")
+					{
+						reply = "ok stopped\n";
+						stop = true;
+					}
+					else if (!command.empty()) // Empty when probed by Daemon()
+						reply = "error\nUnknown request '" + command + "'";
+					if (!reply.empty())
+						send_all(client, reply);
+				} catch (...) {
+					log::warning("Daemon request failed:", error_string());
+				}
+				::close(client);
+				if (stop)
+					break;
+			}
+		}
+#endif
+	}
+
+	boost::optional<std::string>
+	Daemon::request(path_t const& build_directory,
+	                std::string const& command,
+	                std::vector<std::string> const& args)
+	{
+#ifdef __linux__
+		auto path = socket_path(build_directory);
+		if (!fs::exists(path))
+			return boost::none;
+		int fd = connect_to(path);
+		if (fd == -1)
+			return boost::none;
+		std::string request = command + '\0';
+		for (auto& arg: args)
+			request += arg + '\0';
+		if (command == "configure")
+			for (char** env = environ; *env != nullptr; ++env)
+				request += std::string(*env) + '\0';
+		request += '\0';
+		std::string reply;
+		try {
+			send_all(fd, request);
+			reply = recv_until(fd, std::string());
+		} catch (...) {
+			::close(fd);
+			throw;
+		}
+		::close(fd);
+		if (boost::starts_with(reply, "ok "))
+			return boost::trim_copy(reply.substr(3));
+		auto pos = reply.find('\n');
+		if (boost::starts_with(reply, "refused\n"))
+		{
+			log::verbose("The daemon in", build_directory, "refused to configure:",
+			             reply.substr(pos + 1));
+			return boost::none;
+		}
+		CONFIGURE_THROW(
+			error::BuildError(
+				pos != std::string::npos ? reply.substr(pos + 1) : reply
+			) << error::path(build_directory)
+		);
+#else
+		return boost::none;
+#endif
+	}
+
+	Daemon::path_t Daemon::socket_path(path_t const& build_directory)
+	{ return build_directory / ".build" / "daemon.sock"; }
+
+}
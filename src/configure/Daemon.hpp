@@ -0,0 +1,58 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace configure {
+
+	// Keep a build directory configured in the background.
+	//
+	// The daemon configures the build directory once, then watches the
+	// inputs recorded in its manifest and configures again whenever one of
+	// them changes. Clients talk to it through a Unix socket in the build
+	// directory, a request returns as soon as the build files are up to date.
+	class Daemon
+	{
+	public:
+		typedef boost::filesystem::path path_t;
+
+		// Configure the build directory and return a short status.
+		typedef std::function<std::string()> configure_t;
+
+	private:
+		struct Impl;
+		std::unique_ptr<Impl> _this;
+
+	public:
+		Daemon(path_t build_directory, configure_t configure);
+		~Daemon();
+
+	public:
+		// Serve requests until a client asks to stop.
+		void run();
+
+	public:
+		// Send a request ("configure" or "stop") to the daemon running in
+		// `build_directory` and return its status, or none if there is no
+		// daemon. Errors reported by the daemon are rethrown.
+		//
+		// A "configure" request takes the project directory as argument,
+		// optionally followed by "NAME=VALUE" environment variables, and
+		// sends the rest of the environment of the calling process. The
+		// daemon refuses it (and none is returned) when the project
+		// directory or one of the environment variables read by the
+		// configuration differ from its own.
+		static boost::optional<std::string>
+		request(path_t const& build_directory,
+		        std::string const& command,
+		        std::vector<std::string> const& args = {});
+
+		static path_t socket_path(path_t const& build_directory);
+	};
+
+}
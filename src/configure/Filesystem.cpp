@@ -1,10 +1,14 @@
 #include "Filesystem.hpp"
 
 #include "Build.hpp"
+#include "Manifest.hpp"
 #include "Rule.hpp"
 #include "ShellCommand.hpp"
+#include "StatCache.hpp"
 #include "error.hpp"
 #include "log.hpp"
+#include "utils/glob.hpp"
+#include "utils/sha256.hpp"
 //#include <boost/algorithm/string/split.hpp>
 //#include <boost/algorithm/string/classification.hpp>
 
@@ -14,12 +18,19 @@
 #include <boost/system/system_error.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
 #ifdef _WIN32
 # include <windows.h>
 # include <Shlwapi.h>
 #else
+# include <dirent.h>
 # include <glob.h>
+# include <sys/stat.h>
 #endif
 
 namespace fs = boost::filesystem;
@@ -131,19 +142,203 @@ namespace configure {
 		return res;
 	}
 
-	std::vector<Path> rglob(Path const& dir, std::string const& pattern)
-	{
-		std::vector<Path> res = glob(dir, pattern);
-		fs::recursive_directory_iterator it(dir), end;
-		for (; it != end; ++it)
+	namespace {
+
+		enum class EntryKind
 		{
-			if (fs::is_directory(it->status()))
+			file,
+			directory,
+			directory_link, // Symbolic link to a directory
+		};
+
+		// Call `fn(name, kind)` for each entry of `dir`. Symbolic links are
+		// resolved to tell files from directories, but not followed.
+		template<typename Fn>
+		void read_directory(Path const& dir, Fn&& fn)
+		{
+#ifdef _WIN32
+			fs::directory_iterator it(dir), end;
+			for (; it != end; ++it)
+			{
+				boost::system::error_code ec;
+				EntryKind kind = EntryKind::file;
+				if (fs::is_directory(it->symlink_status()))
+					kind = EntryKind::directory;
+				else if (fs::is_directory(it->status(ec)))
+					kind = EntryKind::directory_link;
+				fn(it->path().filename().string(), kind);
+			}
+#else
+			DIR* handle = ::opendir(dir.c_str());
+			if (handle == nullptr)
+				throw fs::filesystem_error(
+					"Cannot open directory",
+					dir,
+					boost::system::error_code(errno, boost::system::system_category())
+				);
+			struct dir_guard {
+				DIR* handle;
+				dir_guard(DIR* handle) : handle(handle) {}
+				~dir_guard() { ::closedir(handle); }
+			} guard(handle);
+			while (struct dirent* entry = ::readdir(handle))
 			{
-				auto dir_res = glob(*it, pattern);
-				res.insert(res.end(), dir_res.begin(), dir_res.end());
+				char const* name = entry->d_name;
+				if (name[0] == '.' &&
+				    (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+					continue;
+				unsigned char type = entry->d_type;
+				struct stat st;
+				if (type == DT_UNKNOWN)
+				{
+					// Some filesystems do not fill d_type.
+					if (::lstat((dir / name).c_str(), &st) == 0)
+						type = S_ISDIR(st.st_mode) ? DT_DIR :
+						       S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;
+				}
+				EntryKind kind = EntryKind::file;
+				if (type == DT_DIR)
+					kind = EntryKind::directory;
+				else if (type == DT_LNK &&
+				         ::stat((dir / name).c_str(), &st) == 0 &&
+				         S_ISDIR(st.st_mode))
+					kind = EntryKind::directory_link;
+				fn(std::string(name), kind);
 			}
+#endif
 		}
-		return res;
+
+		// Shared state of a recursive glob.
+		struct Traversal
+		{
+			typedef std::vector<std::string> components_t;
+
+			// Directories waiting to be read before helper threads are
+			// started. Most globs walk a few directories and are done faster
+			// by the calling thread alone, which may itself be one of the
+			// workers configuring projects concurrently.
+			static size_t const parallel_threshold = 32;
+
+			utils::GlobPattern const& pattern;
+			utils::GlobPattern const& excludes;
+			unsigned int const max_threads;
+			std::vector<std::thread> threads; // Started by the caller only
+			std::thread::id const caller;
+			std::mutex mutex;
+			std::condition_variable cond;
+			std::deque<std::pair<Path, components_t>> queue;
+			size_t pending; // Directories queued or being read
+			std::vector<Path> files;
+			std::vector<Path> directories;
+			std::exception_ptr error;
+
+			Traversal(utils::GlobPattern const& pattern,
+			          utils::GlobPattern const& excludes)
+				: pattern(pattern)
+				, excludes(excludes)
+				, max_threads(std::min(8u, std::thread::hardware_concurrency()))
+				, caller(std::this_thread::get_id())
+				, pending(0)
+			{}
+
+			~Traversal()
+			{
+				for (auto& thread: threads)
+					thread.join();
+			}
+
+			void push(Path dir, components_t components)
+			{
+				queue.emplace_back(std::move(dir), std::move(components));
+				pending += 1;
+			}
+
+			void run()
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				while (true)
+				{
+					cond.wait(lock, [&] { return !queue.empty() || pending == 0; });
+					if (queue.empty())
+						return;
+					auto job = std::move(queue.front());
+					queue.pop_front();
+					lock.unlock();
+
+					std::vector<Path> matches, subdirs;
+					std::vector<components_t> subdirs_components;
+					std::exception_ptr err;
+					try {
+						auto components = job.second;
+						read_directory(job.first, [&] (std::string name, EntryKind kind) {
+							components.push_back(std::move(name));
+							if (!excludes.empty() && excludes.match(components))
+								log::debug("Excluding", job.first / components.back());
+							else if (kind == EntryKind::directory)
+							{
+								subdirs.push_back(job.first / components.back());
+								subdirs_components.push_back(components);
+							}
+							else if (kind == EntryKind::directory_link)
+								log::debug("Not following", job.first / components.back());
+							else if (pattern.match(components))
+								matches.push_back(job.first / components.back());
+							components.pop_back();
+						});
+					} catch (...) {
+						err = std::current_exception();
+					}
+
+					lock.lock();
+					if (err && !error)
+						error = err;
+					files.insert(files.end(), matches.begin(), matches.end());
+					for (size_t i = 0; i < subdirs.size(); ++i)
+					{
+						directories.push_back(subdirs[i]);
+						if (!error)
+							this->push(subdirs[i], std::move(subdirs_components[i]));
+					}
+					pending -= 1;
+					if (queue.size() >= parallel_threshold &&
+					    std::this_thread::get_id() == caller)
+					{
+						while (threads.size() + 1 < max_threads)
+							threads.emplace_back([this] { this->run(); });
+					}
+					cond.notify_all();
+				}
+			}
+		};
+
+	}
+
+	std::vector<Path> rglob(Path const& dir,
+	                        std::string const& pattern,
+	                        std::vector<std::string> const& excludes,
+	                        std::vector<Path>* directories)
+	{
+		utils::GlobPattern compiled_pattern(pattern);
+		utils::GlobPattern compiled_excludes(excludes);
+		Traversal traversal(compiled_pattern, compiled_excludes);
+		traversal.push(dir, {});
+		traversal.run();
+		for (auto& thread: traversal.threads)
+			thread.join();
+		traversal.threads.clear();
+		if (traversal.error)
+			std::rethrow_exception(traversal.error);
+
+		// Threads finish in any order.
+		std::sort(traversal.files.begin(), traversal.files.end());
+		if (directories != nullptr)
+		{
+			std::sort(traversal.directories.begin(), traversal.directories.end());
+			directories->insert(directories->end(),
+			                    traversal.directories.begin(),
+			                    traversal.directories.end());
+		}
+		return std::move(traversal.files);
 	}
 
 	std::vector<NodePtr> Filesystem::glob(Path const& dir,
@@ -151,11 +346,25 @@ namespace configure {
 	{
 		Path base_dir =
 		    dir.is_absolute() ? dir : _build.project_directory() / dir;
+		_build.manifest().add_directory(base_dir);
+		// Files added in the directories of the pattern change the result.
+		Path prefix = base_dir;
+		for (auto& part: Path(pattern).parent_path())
+		{
+			if (part.string().find_first_of("*?[") != std::string::npos)
+				break;
+			prefix /= part;
+		}
+		if (prefix != base_dir)
+			_build.manifest().add_directory(prefix);
 		auto paths = configure::glob(base_dir, pattern);
 		std::vector<NodePtr> res;
 		res.reserve(paths.size());
 		for (auto&& p: paths)
+		{
+			_build.manifest().add_directory(p.parent_path());
 			res.emplace_back(_build.source_node(std::move(p)));
+		}
 		return res;
 	}
 
@@ -165,11 +374,15 @@ namespace configure {
 	}
 
 	std::vector<NodePtr> Filesystem::rglob(Path const& dir,
-	                                       std::string const& pattern)
+	                                       std::string const& pattern,
+	                                       std::vector<std::string> const& excludes)
 	{
 		Path base_dir =
 		    dir.is_absolute() ? dir : _build.project_directory() / dir;
-		auto paths = configure::rglob(base_dir, pattern);
+		std::vector<Path> directories{base_dir};
+		auto paths = configure::rglob(base_dir, pattern, excludes, &directories);
+		for (auto& d: directories)
+			_build.manifest().add_directory(d);
 		std::vector<NodePtr> res;
 		res.reserve(paths.size());
 		for (auto&& p: paths)
@@ -193,6 +406,7 @@ namespace configure {
 		if (!dir.is_absolute())
 			return this->list_directory(_build.project_directory() / dir);
 
+		_build.manifest().add_directory(dir);
 		std::vector<NodePtr> res;
 		fs::directory_iterator it(dir), end;
 		for (; it != end; ++it)
@@ -213,7 +427,8 @@ namespace configure {
 		for (auto& dir: directories)
 		{
 			auto path = dir / file;
-			if (fs::is_regular_file(path))
+			_build.manifest().add_path(path);
+			if (StatCache::instance().is_regular_file(path))
 				return _build.file_node(path);
 		}
 		CONFIGURE_THROW(
@@ -231,7 +446,9 @@ namespace configure {
 	boost::optional<Path> Filesystem::which(std::string const& program_name)
 	{
 		Path program(program_name);
-		if ((program.is_absolute() || program.is_relative()) && fs::is_regular_file(program))
+		auto& cache = StatCache::instance();
+		if ((program.is_absolute() || program.is_relative()) &&
+		    cache.is_regular_file(program))
 			return fs::absolute(program);
 		char const* PATH = ::getenv("PATH");
 		if (PATH == nullptr)
@@ -250,7 +467,7 @@ namespace configure {
 			//		full = Path(el) / full;
 			//}
 
-			if (fs::is_regular_file(full))
+			if (cache.is_regular_file(full))
 				return full;
 		}
 #ifdef _WIN32
@@ -260,25 +477,74 @@ namespace configure {
 		return boost::none;
 	}
 
+	boost::optional<Path> Filesystem::find_program(std::string const& program)
+	{
+		auto res = which(program);
+		_build.manifest().add_program(program, res);
+		return res;
+	}
+
 	NodePtr& Filesystem::copy(Path src, Path dst)
 	{ return this->copy(_build.source_node(std::move(src)), std::move(dst)); }
 
 	NodePtr& Filesystem::copy(NodePtr& src_node, Path dst)
 	{
 		auto& dst_node = _build.target_node(std::move(dst));
-		ShellCommand cmd;
-		cmd.append(
-			_build.option<Path>("CP", "Copy program", "cp"),
-			src_node,
-			dst_node
-		);
-		_build.add_rule(
-			Rule()
-				.add_source(src_node)
-				.add_target(dst_node)
-				.add_shell_command(std::move(cmd))
-		);
+		this->_add_copy_rule({{src_node, dst_node}});
 		return dst_node;
 	}
 
+	std::vector<NodePtr>
+	Filesystem::copy(std::vector<std::pair<NodePtr, Path>> const& files)
+	{
+		// Unchanged destinations are not touched, the stamp tells make that
+		// the rule is up to date. It is created first: generators run the
+		// commands for the first target of a rule.
+		NodePtr stamp;
+		if (files.size() > 1)
+		{
+			std::string destinations;
+			for (auto& pair: files)
+				destinations += pair.second.string() + '\n';
+			stamp = _build.target_node(
+			    _build.directory() / ".build" / "stamps" /
+			    ("copy-" + utils::sha256(destinations).substr(0, 16)));
+		}
+		std::vector<std::pair<NodePtr, NodePtr>> nodes;
+		std::vector<NodePtr> res;
+		for (auto& pair: files)
+		{
+			nodes.emplace_back(pair.first, _build.target_node(pair.second));
+			res.push_back(nodes.back().second);
+		}
+		if (!nodes.empty())
+			this->_add_copy_rule(nodes, stamp);
+		return res;
+	}
+
+	void Filesystem::_add_copy_rule(
+	    std::vector<std::pair<NodePtr, NodePtr>> const& files,
+	    NodePtr const& stamp)
+	{
+		// The builtin copy only rewrites destinations whose content differ.
+		ShellCommand cmd;
+		cmd.append(_build.configure_program(), "-E", "copy");
+		if (_build.option<bool>("COPY_HARDLINK",
+		                        "Hard link copied files when possible",
+		                        false))
+			cmd.append("--hardlink");
+		Rule rule;
+		if (stamp != nullptr)
+		{
+			cmd.append("--stamp", stamp);
+			rule.add_target(stamp);
+		}
+		for (auto& pair: files)
+		{
+			cmd.append(pair.first, pair.second);
+			rule.add_source(pair.first).add_target(pair.second);
+		}
+		_build.add_rule(rule.add_shell_command(std::move(cmd)));
+	}
+
 }
@@ -5,6 +5,7 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/optional.hpp>
 
+#include <utility>
 #include <vector>
 #include <string>
 
@@ -15,7 +16,18 @@ namespace configure {
 	std::vector<Path> list_directory(Path const& dir);
 
 	std::vector<Path> glob(Path const& dir, std::string const& pattern);
-	std::vector<Path> rglob(Path const& dir, std::string const& pattern);
+	// Recursive glob, in one traversal of `dir` (spread over a few threads
+	// for large trees). The pattern may contain `**` and brace sets, it is
+	// matched against paths relative to `dir`. As when globbing in every
+	// directory, a pattern without `**` matches at any depth: "src/*.c"
+	// matches "src/a.c" and "lib/src/a.c". Only files are returned, and
+	// symbolic links to directories are not followed. Files and directories
+	// matching one of the `excludes` patterns are skipped. Visited
+	// directories are appended to `directories` when not null.
+	std::vector<Path> rglob(Path const& dir,
+	                        std::string const& pattern,
+	                        std::vector<std::string> const& excludes = {},
+	                        std::vector<Path>* directories = nullptr);
 
 	class Filesystem
 	{
@@ -26,15 +38,33 @@ namespace configure {
 		Filesystem(Build& build);
 		~Filesystem();
 
+		Build& build() const { return _build; }
+
 		std::vector<NodePtr> glob(std::string const& pattern);
 		std::vector<NodePtr> glob(Path const& dir, std::string const& pattern);
-		std::vector<NodePtr> rglob(Path const& dir, std::string const& pattern);
+		std::vector<NodePtr> rglob(Path const& dir,
+		                           std::string const& pattern,
+		                           std::vector<std::string> const& excludes = {});
 		std::vector<NodePtr> list_directory(Path const& dir);
 		NodePtr& find_file(std::vector<Path> const& directories,
 		                   Path const& file);
 		static boost::optional<Path> which(std::string const& program);
+
+		// Same as which(), but the lookup is recorded as a configuration
+		// input.
+		boost::optional<Path> find_program(std::string const& program);
 		NodePtr& copy(Path src, Path dst);
 		NodePtr& copy(NodePtr& src, Path dst);
+
+		// Copy many files (source and destination pairs) with a single
+		// rule and return the destination nodes. The rule also updates a
+		// stamp file, its first target.
+		std::vector<NodePtr>
+		copy(std::vector<std::pair<NodePtr, Path>> const& files);
+
+	private:
+		void _add_copy_rule(std::vector<std::pair<NodePtr, NodePtr>> const& files,
+		                    NodePtr const& stamp = nullptr);
 	};
 
 }
@@ -1,5 +1,10 @@
 #include "Generator.hpp"
 
+#include "Build.hpp"
+#include "Command.hpp"
+#include "Node.hpp"
+#include "ShellCommand.hpp"
+
 namespace configure {
 
 	Generator::Generator(Build& build,
@@ -18,4 +23,96 @@ namespace configure {
 	void Generator::prepare()
 	{}
 
+	namespace {
+
+		std::string const* string_arg(ShellCommand::Arg const& arg)
+		{ return boost::get<std::string>(&arg); }
+
+		boost::filesystem::path const* path_arg(ShellCommand::Arg const& arg)
+		{
+			if (auto path = boost::get<boost::filesystem::path>(&arg))
+				return path;
+			if (auto node = boost::get<NodePtr>(&arg))
+				if ((*node)->is_file())
+					return &(*node)->path();
+			return nullptr;
+		}
+
+	}
+
+	std::vector<ShellCommand>
+	Generator::shell_commands(Command const& command) const
+	{
+		// Commands that can be merged: no environment or working directory,
+		// and nothing that would be mistaken for a separator.
+		auto is_builtin = [&](ShellCommand const& cmd) {
+			auto& args = cmd.args();
+			if (cmd.has_working_directory() || cmd.has_env() || args.size() < 3)
+				return false;
+			auto program = path_arg(args[0]);
+			if (program == nullptr ||
+			    (*program != _configure_exe &&
+			     *program != _build.configure_program()))
+				return false;
+			auto flag = string_arg(args[1]), name = string_arg(args[2]);
+			if (flag == nullptr || *flag != "-E" ||
+			    name == nullptr || *name == "batch")
+				return false;
+			for (auto& arg: args)
+				if (auto str = string_arg(arg))
+					if (*str == "--then" || *str == "--next")
+						return false;
+			return true;
+		};
+
+		std::vector<ShellCommand> res;
+		auto& commands = command.shell_commands();
+		for (size_t i = 0; i < commands.size();)
+		{
+			size_t end = i;
+			while (end < commands.size() && is_builtin(commands[end]))
+				end += 1;
+			if (end - i < 2)
+			{
+				res.push_back(commands[i]);
+				i += 1;
+				continue;
+			}
+
+			// Arguments of each built-in, calls to the same Lua function
+			// share one interpreter.
+			typedef std::vector<ShellCommand::Arg> args_t;
+			std::vector<args_t> calls;
+			for (; i < end; ++i)
+			{
+				auto& args = commands[i].args();
+				args_t call(args.begin() + 2, args.end());
+				if (!calls.empty() && call.size() >= 3 &&
+				    calls.back()[0] == call[0] &&
+				    *string_arg(call[0]) == "lua-function" &&
+				    calls.back()[1] == call[1] && calls.back()[2] == call[2])
+				{
+					calls.back().push_back(std::string("--next"));
+					calls.back().insert(calls.back().end(), call.begin() + 3, call.end());
+				}
+				else
+					calls.push_back(std::move(call));
+			}
+
+			ShellCommand batch;
+			batch.append(commands[end - 1].args()[0], "-E");
+			if (calls.size() > 1)
+				batch.append("batch");
+			for (auto& call: calls)
+			{
+				if (&call != &calls.front())
+					batch.append("--then");
+				for (auto& arg: call)
+					batch.append(arg);
+			}
+			res.push_back(std::move(batch));
+		}
+		return res;
+	}
+
 }
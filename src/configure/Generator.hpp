@@ -29,6 +29,8 @@ namespace configure {
 
 		std::string const& name() const { return _name; }
 
+		Build& build() const { return _build; }
+
 	public:
 		// Prepare the generator and the build, might alter the build graph.
 		virtual void prepare();
@@ -40,6 +42,14 @@ namespace configure {
 		virtual
 		std::vector<std::string>
 		build_command(std::string const& target) const = 0;
+
+		// Files written by generate().
+		virtual std::vector<path_t> build_files() const = 0;
+
+	protected:
+		// Shell commands of `command`, where consecutive built-in commands
+		// (`configure -E ...`) are merged into one `configure -E batch`.
+		std::vector<ShellCommand> shell_commands(Command const& command) const;
 	};
 
 }
@@ -0,0 +1,258 @@
+#include "Manifest.hpp"
+
+#include "Filesystem.hpp"
+#include "error.hpp"
+#include "log.hpp"
+#include "utils/path.hpp"
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/optional.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <set>
+
+#ifndef _WIN32
+# include <sys/stat.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace configure {
+
+	namespace {
+
+		// Bump when the manifest format changes.
+		unsigned int const manifest_version = 1;
+
+	}
+
+	Manifest::Manifest()
+	{}
+
+	Manifest::~Manifest()
+	{}
+
+	void Manifest::project_directory(path_t const& dir)
+	{ _project_directory = dir; }
+
+	void Manifest::arguments(std::map<std::string, std::string> const& args)
+	{ _arguments = args; }
+
+	void Manifest::add_file(path_t const& path)
+	{
+		// Keep the first stamp, files modified during the configuration
+		// will be seen as changed on the next run.
+		if (_files.find(path) == _files.end())
+			_files[path] = stamp(path);
+	}
+
+	void Manifest::add_directory(path_t const& path)
+	{
+		if (_directories.find(path) == _directories.end())
+			_directories[path] = stamp(path);
+	}
+
+	void Manifest::add_path(path_t const& path)
+	{
+		if (_paths.find(path) == _paths.end())
+			_paths[path] = fs::exists(path);
+	}
+
+	void Manifest::add_program(std::string const& name,
+	                           boost::optional<path_t> const& result)
+	{
+		_programs[name] = result ? result->string() : std::string();
+		if (result)
+			this->add_file(*result);
+	}
+
+	void Manifest::add_variable(std::string const& name,
+	                            boost::optional<std::string> const& value)
+	{ _variables[name] = value; }
+
+	void Manifest::add_written_file(path_t const& path)
+	{ _written_files[path] = stamp(path); }
+
+	void Manifest::add_output(path_t const& path)
+	{ _outputs[path] = stamp(path); }
+
+	void Manifest::merge(Manifest const& other)
+	{
+		_files.insert(other._files.begin(), other._files.end());
+		_directories.insert(other._directories.begin(), other._directories.end());
+		_paths.insert(other._paths.begin(), other._paths.end());
+		_programs.insert(other._programs.begin(), other._programs.end());
+		_variables.insert(other._variables.begin(), other._variables.end());
+		_written_files.insert(other._written_files.begin(), other._written_files.end());
+		_outputs.insert(other._outputs.begin(), other._outputs.end());
+	}
+
+	void Manifest::clear()
+	{
+		_project_directory.clear();
+		_arguments.clear();
+		_files.clear();
+		_directories.clear();
+		_paths.clear();
+		_programs.clear();
+		_variables.clear();
+		_written_files.clear();
+		_outputs.clear();
+	}
+
+	boost::optional<std::string>
+	Manifest::find_change(path_t const& project_directory,
+	                      std::map<std::string, std::string> const& args) const
+	{
+		if (project_directory != _project_directory)
+			return std::string("project directory changed");
+		for (auto& pair: args)
+		{
+			auto it = _arguments.find(pair.first);
+			if (it == _arguments.end() || it->second != pair.second)
+				return "argument " + pair.first + " changed";
+		}
+		for (auto& pair: _files)
+			if (stamp(pair.first) != pair.second)
+				return "file " + pair.first.string() + " changed";
+		for (auto& pair: _directories)
+			if (stamp(pair.first) != pair.second)
+				return "directory " + pair.first.string() + " changed";
+		for (auto& pair: _paths)
+			if (fs::exists(pair.first) != pair.second)
+				return "path " + pair.first.string() + " changed";
+		for (auto& pair: _programs)
+		{
+			auto res = Filesystem::which(pair.first);
+			if ((res ? res->string() : std::string()) != pair.second)
+				return "program " + pair.first + " changed";
+		}
+		for (auto& pair: _variables)
+		{
+			char const* value = std::getenv(pair.first.c_str());
+			if ((value != nullptr) != bool(pair.second) ||
+			    (value != nullptr && *pair.second != value))
+				return "environment variable " + pair.first + " changed";
+		}
+		for (auto& pair: _written_files)
+			if (stamp(pair.first) != pair.second)
+				return "file " + pair.first.string() + " written by the configuration changed";
+		return boost::none;
+	}
+
+	bool Manifest::is_up_to_date(path_t const& path) const
+	{
+		auto it = _outputs.find(path);
+		return it != _outputs.end() && stamp(path) == it->second;
+	}
+
+	bool Manifest::is_up_to_date() const
+	{
+		for (auto& pair: _outputs)
+			if (stamp(pair.first) != pair.second)
+				return false;
+		return !_outputs.empty();
+	}
+
+	std::vector<Manifest::path_t> Manifest::input_directories() const
+	{
+		std::set<path_t> res;
+		for (auto& pair: _files)
+			res.insert(pair.first.parent_path());
+		for (auto& pair: _paths)
+			res.insert(pair.first.parent_path());
+		for (auto& pair: _directories)
+			res.insert(pair.first);
+		res.erase(path_t());
+		return std::vector<path_t>(res.begin(), res.end());
+	}
+
+	void Manifest::load(path_t const& path)
+	{
+		std::ifstream in(path.string(), std::ios::binary);
+		boost::archive::binary_iarchive ar(in);
+		unsigned int version;
+		ar >> version;
+		if (version != manifest_version)
+			CONFIGURE_THROW(
+				error::InvalidEnviron(
+					"Unsupported manifest version " + std::to_string(version))
+				<< error::path(path)
+			);
+		ar & *this;
+	}
+
+	void Manifest::save(path_t const& path) const
+	{
+		std::ofstream out(path.string(), std::ios::binary);
+		boost::archive::binary_oarchive ar(out);
+		ar << manifest_version;
+		ar & *this;
+	}
+
+	template<typename Archive>
+	void Manifest::serialize(Archive& ar, unsigned int const)
+	{
+		ar & _project_directory;
+		ar & _arguments;
+		ar & _files;
+		ar & _directories;
+		ar & _paths;
+		ar & _programs;
+		ar & _variables;
+		ar & _written_files;
+		ar & _outputs;
+	}
+
+	Manifest::Stamp Manifest::stamp(path_t const& path)
+	{
+		Stamp res{false, 0, 0};
+		boost::system::error_code ec;
+#ifdef _WIN32
+		auto status = fs::status(path, ec);
+		if (ec || !fs::exists(status))
+			return res;
+		res.mtime = fs::last_write_time(path, ec) * int64_t(1000000000);
+		bool is_directory = fs::is_directory(status);
+		if (fs::is_regular_file(status))
+			res.size = fs::file_size(path, ec);
+#else
+		struct stat st;
+		if (::stat(path.c_str(), &st) != 0)
+			return res;
+# ifdef __APPLE__
+		auto const& mtime = st.st_mtimespec;
+# else
+		auto const& mtime = st.st_mtim;
+# endif
+		res.mtime = mtime.tv_sec * int64_t(1000000000) + mtime.tv_nsec;
+		bool is_directory = S_ISDIR(st.st_mode);
+		if (S_ISREG(st.st_mode))
+			res.size = st.st_size;
+#endif
+		res.exists = true;
+		if (is_directory)
+		{
+			// The modification time may have a coarse resolution, entries
+			// added or removed within the same tick are still seen.
+			for (fs::directory_iterator it(path, ec), end; !ec && it != end;
+			     it.increment(ec))
+				res.size += 1;
+		}
+		return res;
+	}
+
+#define INSTANCIATE(T) \
+	template \
+	void Manifest::serialize<T>(T&, unsigned int const); \
+
+	INSTANCIATE(boost::archive::binary_iarchive);
+	INSTANCIATE(boost::archive::binary_oarchive);
+#undef INSTANCIATE
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace configure {
+
+	// Record everything a configuration run depended on.
+	//
+	// The manifest is filled while the configuration scripts run (loaded
+	// scripts, globbed directories, probed files and programs, environment
+	// variables, command line arguments) and saved in the build directory
+	// once the build files have been generated. When none of the recorded
+	// inputs changed, a subsequent run can skip the configuration entirely.
+	class Manifest
+	{
+	public:
+		typedef boost::filesystem::path path_t;
+
+		// Last known state of a file or a directory.
+		struct Stamp
+		{
+			bool exists;
+			int64_t mtime; // In nanoseconds
+			uintmax_t size;
+
+			bool operator ==(Stamp const& other) const
+			{
+				return exists == other.exists &&
+				       mtime == other.mtime &&
+				       size == other.size;
+			}
+
+			bool operator !=(Stamp const& other) const
+			{ return !(*this == other); }
+
+			template<typename Archive>
+			void serialize(Archive& ar, unsigned int const)
+			{ ar & exists & mtime & size; }
+		};
+
+	private:
+		path_t                             _project_directory;
+		std::map<std::string, std::string> _arguments;
+		std::map<path_t, Stamp>            _files;
+		std::map<path_t, Stamp>            _directories;
+		std::map<path_t, bool>             _paths;
+		std::map<std::string, std::string> _programs;
+		std::map<std::string, boost::optional<std::string>> _variables;
+		std::map<path_t, Stamp>            _written_files;
+		std::map<path_t, Stamp>            _outputs;
+
+	public:
+		Manifest();
+		~Manifest();
+
+	public:
+		// Project configured.
+		void project_directory(path_t const& dir);
+		path_t const& project_directory() const { return _project_directory; }
+
+		// Command line arguments given to the build.
+		void arguments(std::map<std::string, std::string> const& args);
+		std::map<std::string, std::string> const& arguments() const
+		{ return _arguments; }
+
+		// A file whose content was read (script, binary, ...).
+		void add_file(path_t const& path);
+
+		// A directory whose entries were listed.
+		void add_directory(path_t const& path);
+
+		// A path whose existence was checked.
+		void add_path(path_t const& path);
+
+		// A program looked up in the PATH (and the result of the lookup).
+		void add_program(std::string const& name,
+		                 boost::optional<path_t> const& result);
+
+		// An environment variable read (and its value, if set).
+		void add_variable(std::string const& name,
+		                  boost::optional<std::string> const& value);
+		std::map<std::string, boost::optional<std::string>> const&
+		variables() const
+		{ return _variables; }
+
+		// A file written by the configuration scripts. Unlike outputs, it is
+		// only written again by configuring.
+		void add_written_file(path_t const& path);
+
+		// A file generated by the configuration.
+		void add_output(path_t const& path);
+
+		// Add the inputs and outputs of another manifest.
+		void merge(Manifest const& other);
+
+		// Forget everything.
+		void clear();
+
+	public:
+		// Return a description of the first input that changed, or none if
+		// the configuration of `project_directory` with `args` is up to date.
+		boost::optional<std::string>
+		find_change(path_t const& project_directory,
+		            std::map<std::string, std::string> const& args) const;
+
+		// Whether `path` was generated from these inputs and did not change
+		// since.
+		bool is_up_to_date(path_t const& path) const;
+
+		// Whether some files were generated and none of them changed.
+		bool is_up_to_date() const;
+
+		// Directories where a change may invalidate the configuration.
+		std::vector<path_t> input_directories() const;
+
+	public:
+		// Throws when the file was saved with another format version.
+		void load(path_t const& path);
+		void save(path_t const& path) const;
+
+		template<typename Archive>
+		void serialize(Archive& ar, unsigned int const);
+
+	public:
+		static Stamp stamp(path_t const& path);
+	};
+
+}
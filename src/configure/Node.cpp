@@ -2,6 +2,7 @@
 #include "BuildGraph.hpp"
 #include "error.hpp"
 #include "PropertyMap.hpp"
+#include "StatCache.hpp"
 #include "utils/path.hpp"
 #include "log.hpp"
 
@@ -57,7 +58,7 @@ namespace configure {
 			  "Only file nodes support lazy properties, got " +
 			  this->string()));
 		std::time_t modification_time =
-		  boost::filesystem::last_write_time(this->path());
+		  StatCache::instance().last_write_time(this->path());
 		if (!this->has_property(key) ||
 		    (!this->properties().dirty("last-write-time") &&
 		     (!this->has_property("last-write-time") ||
@@ -0,0 +1,118 @@
+#include "ProbeCache.hpp"
+
+#include "error.hpp"
+#include "log.hpp"
+#include "utils/path.hpp"
+#include "utils/sha256.hpp"
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/serialization/variant.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <fstream>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/file.h>
+# include <unistd.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace configure {
+
+	namespace {
+
+		// Exclusive lock held as long as the instance lives.
+		struct FileLock
+		{
+#ifndef _WIN32
+			int fd;
+
+			explicit FileLock(fs::path const& path)
+				: fd(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644))
+			{
+				if (fd == -1)
+					CONFIGURE_THROW(CONFIGURE_SYSTEM_ERROR("open()") << error::path(path));
+				while (::flock(fd, LOCK_EX) != 0)
+					if (errno != EINTR)
+					{
+						::close(fd);
+						CONFIGURE_THROW(CONFIGURE_SYSTEM_ERROR("flock()") << error::path(path));
+					}
+			}
+
+			~FileLock()
+			{ ::close(fd); }
+#else
+			explicit FileLock(fs::path const&) {}
+#endif
+		};
+
+		bool read_entry(fs::path const& path, Environ::Value& value)
+		{
+			std::ifstream in(path.string(), std::ios::binary);
+			if (!in)
+				return false;
+			try {
+				boost::archive::binary_iarchive ar(in);
+				ar >> value;
+				return true;
+			} catch (...) {
+				log::debug("Ignoring invalid probe cache entry", path, ":",
+				           error_string());
+				return false;
+			}
+		}
+
+		void write_entry(fs::path const& path, Environ::Value const& value)
+		{
+			auto tmp = path.string() + fs::unique_path(".%%%%%%%%").string();
+			{
+				std::ofstream out(tmp, std::ios::binary);
+				boost::archive::binary_oarchive ar(out);
+				ar << value;
+			}
+			fs::rename(tmp, path);
+		}
+
+	}
+
+	ProbeCache::ProbeCache(path_t directory)
+		: _directory(std::move(directory))
+	{}
+
+	ProbeCache& ProbeCache::instance()
+	{
+		static ProbeCache cache(
+			utils::user_cache_directory("probes", "CONFIGURE_PROBE_CACHE_DIR")
+		);
+		return cache;
+	}
+
+	Environ::Value ProbeCache::get(std::string const& key,
+	                               compute_t const& compute)
+	{
+		if (_directory.empty())
+			return compute();
+		auto hash = utils::sha256(key);
+		auto dir = _directory / hash.substr(0, 2);
+		auto entry = dir / hash;
+		Environ::Value value;
+		if (read_entry(entry, value))
+			return value;
+
+		fs::create_directories(dir);
+		FileLock lock(entry.string() + ".lock");
+		// Another configure might have computed it while we were waiting.
+		if (read_entry(entry, value))
+			return value;
+		log::debug("Computing probe", hash);
+		value = compute();
+		write_entry(entry, value);
+		return value;
+	}
+
+}
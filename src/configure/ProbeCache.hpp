@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Environ.hpp"
+
+#include <boost/filesystem/path.hpp>
+
+#include <functional>
+#include <string>
+
+namespace configure {
+
+	// Results of expensive checks (compiler probes) shared between build
+	// directories.
+	//
+	// Entries are stored in a per user directory, one file per key. Keys
+	// must describe everything the result depends on (e.g. the compiler
+	// identity, the probe source and its arguments). Concurrent configures
+	// computing the same entry are serialized with a file lock.
+	class ProbeCache
+	{
+	public:
+		typedef boost::filesystem::path path_t;
+		typedef std::function<Environ::Value()> compute_t;
+
+	private:
+		path_t _directory;
+
+	public:
+		// An empty directory disables the cache.
+		explicit ProbeCache(path_t directory);
+
+		// Use the CONFIGURE_PROBE_CACHE_DIR or the user cache directory.
+		static ProbeCache& instance();
+
+	public:
+		path_t const& directory() const { return _directory; }
+
+		// Return the cached value for `key`, or compute and store it.
+		Environ::Value get(std::string const& key, compute_t const& compute);
+	};
+
+}
@@ -3,6 +3,7 @@
 #include "Filesystem.hpp"
 #include "quote.hpp"
 #include "error.hpp"
+#include "StatCache.hpp"
 
 #include <boost/config.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -15,6 +16,7 @@
 #include <string.h>
 
 #if defined(BOOST_POSIX_API)
+# include <fcntl.h>
 # include <sys/wait.h>
 # include <unistd.h>
 # if defined(__APPLE__) && defined(__DYNAMIC__)
@@ -61,9 +63,17 @@ namespace configure {
 #ifdef BOOST_WINDOWS_API
 				if (!::CreatePipe(&fds[0], &fds[1], NULL, 0))
 					CONFIGURE_THROW_SYSTEM_ERROR("CreatePipe()");
-#else
+#elif defined(__APPLE__)
+				// No pipe2(), the flag is set after the creation.
 				if (::pipe(fds) == -1)
 					CONFIGURE_THROW_SYSTEM_ERROR("pipe()");
+				::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+				::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#else
+				// Processes are spawned from several threads, the children
+				// must not inherit the pipes of the others.
+				if (::pipe2(fds, O_CLOEXEC) == -1)
+					CONFIGURE_THROW_SYSTEM_ERROR("pipe2()");
 #endif
 				_source = io::file_descriptor_source(
 				  fds[0], io::file_descriptor_flags::close_handle);
@@ -243,6 +253,17 @@ namespace configure {
 					std::get<2>(channel).reset(new Pipe);
 				}
 
+			// Nothing is allocated or logged in the child: another thread
+			// could hold the allocator or the log lock when forking.
+			std::vector<char const*> args;
+			for (auto& arg: this->command)
+				args.push_back(arg.c_str());
+			args.push_back(nullptr);
+			std::string chdir_error;
+			if (this->options.working_directory)
+				chdir_error = "Cannot set working directory to '" +
+					this->options.working_directory.get().string() + "'\n";
+
 			log::debug("Spawning process:", boost::join(this->command, " "));
 			pid_t child = ::fork();
 			if (child < 0)
@@ -256,10 +277,9 @@ namespace configure {
 					auto const& dir = this->options.working_directory.get();
 					if (::chdir(dir.c_str()) < 0)
 					{
-						log::error("Cannot set working directory to '" +
-						             dir.string() + "':",
-						           ::strerror(errno));
-						::exit(EXIT_FAILURE);
+						(void) ::write(STDERR_FILENO, chdir_error.data(),
+						               chdir_error.size());
+						::_exit(EXIT_FAILURE);
 					}
 				}
 				for (auto& channel: channels)
@@ -272,28 +292,22 @@ namespace configure {
 						int new_fd = (is_sink ?
 						              std::get<2>(channel)->sink().handle() :
 						              std::get<2>(channel)->source().handle());
+						if (new_fd == old_fd)
+							::fcntl(old_fd, F_SETFD, 0);
 					retry_dup2:
 						int ret = ::dup2(new_fd, old_fd);
 						if (ret == -1) {
 							if (errno == EINTR) goto retry_dup2;
-							::exit(EXIT_FAILURE);
+							::_exit(EXIT_FAILURE);
 						}
 					}
 					else if (kind == Stream::DEVNULL)
-					{
-						log::debug("Closing", old_fd);
 						::close(old_fd);
-					}
 				}
-				stdin_pipe.reset();
-				stdout_pipe.reset();
-				stderr_pipe.reset();
-				std::vector<char const*> args;
-				for (auto& arg: this->command)
-					args.push_back(arg.c_str());
-				args.push_back(nullptr);
+				// The pipes are closed on exec, dup2() cleared the flag of
+				// the standard descriptors.
 				::execve(args[0], (char**) &args[0], env);
-				::exit(EXIT_FAILURE);
+				::_exit(EXIT_FAILURE);
 			}
 			else // Parent
 			{
@@ -439,7 +453,11 @@ namespace configure {
 		{
 			int exit_code;
 			if (_this->child.wait(0, exit_code))
+			{
 				_this->exit_code = exit_code;
+				// The child may have changed anything.
+				StatCache::instance().invalidate();
+			}
 		}
 		return _this->exit_code;
 	}
@@ -454,6 +472,7 @@ namespace configure {
 			if (!ended)
 				throw std::logic_error("Should be terminated");
 			_this->exit_code = exit_code;
+			StatCache::instance().invalidate();
 		}
 		return _this->exit_code.get();
 	}
@@ -0,0 +1,153 @@
+#include "StatCache.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <map>
+#include <mutex>
+
+#ifndef _WIN32
+# include <sys/stat.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace configure {
+
+	namespace {
+
+		StatCache::Status read_status(fs::path const& path)
+		{
+			StatCache::Status res{false, false, false, 0};
+#ifdef _WIN32
+			boost::system::error_code ec;
+			auto status = fs::status(path, ec);
+			if (ec || !fs::exists(status))
+				return res;
+			res.is_regular_file = fs::is_regular_file(status);
+			res.is_directory = fs::is_directory(status);
+			res.mtime = fs::last_write_time(path, ec);
+#else
+			// A single syscall gives everything.
+			struct stat st;
+			if (::stat(path.c_str(), &st) != 0)
+				return res;
+			res.is_regular_file = S_ISREG(st.st_mode);
+			res.is_directory = S_ISDIR(st.st_mode);
+			res.mtime = st.st_mtime;
+#endif
+			res.exists = true;
+			return res;
+		}
+
+	}
+
+	struct StatCache::Impl
+	{
+		std::mutex                                mutex;
+		std::map<std::string, Status>             entries; // Sorted by path
+		size_t                                    hits;
+		size_t                                    misses;
+
+		Impl()
+			: mutex()
+			, entries()
+			, hits(0)
+			, misses(0)
+		{}
+	};
+
+	StatCache::StatCache()
+		: _this(new Impl)
+	{}
+
+	StatCache::~StatCache()
+	{}
+
+	StatCache& StatCache::instance()
+	{
+		static StatCache cache;
+		return cache;
+	}
+
+	StatCache::Status StatCache::status(path_t const& path)
+	{
+		bool cacheable = path.is_absolute();
+		if (cacheable)
+		{
+			std::lock_guard<std::mutex> guard(_this->mutex);
+			auto it = _this->entries.find(path.string());
+			if (it != _this->entries.end())
+			{
+				_this->hits += 1;
+				return it->second;
+			}
+		}
+		auto res = read_status(path);
+		std::lock_guard<std::mutex> guard(_this->mutex);
+		_this->misses += 1;
+		if (cacheable)
+			_this->entries.emplace(path.string(), res);
+		return res;
+	}
+
+	bool StatCache::exists(path_t const& path)
+	{ return this->status(path).exists; }
+
+	bool StatCache::is_regular_file(path_t const& path)
+	{ return this->status(path).is_regular_file; }
+
+	bool StatCache::is_directory(path_t const& path)
+	{ return this->status(path).is_directory; }
+
+	std::time_t StatCache::last_write_time(path_t const& path)
+	{
+		auto status = this->status(path);
+		if (!status.exists)
+			throw fs::filesystem_error(
+				"Cannot get the last write time",
+				path,
+				boost::system::errc::make_error_code(
+					boost::system::errc::no_such_file_or_directory
+				)
+			);
+		return status.mtime;
+	}
+
+	void StatCache::invalidate(path_t const& path)
+	{
+		std::string const key = path.string();
+		std::lock_guard<std::mutex> guard(_this->mutex);
+		auto& entries = _this->entries;
+		entries.erase(key);
+		// Adding or removing an entry changes the directory too.
+		entries.erase(path.parent_path().string());
+		// Entries below `path` follow it in the map.
+		for (char separator: {'/', '\\'})
+		{
+			std::string const prefix = key + separator;
+			auto it = entries.lower_bound(prefix);
+			while (it != entries.end() &&
+			       it->first.compare(0, prefix.size(), prefix) == 0)
+				it = entries.erase(it);
+		}
+	}
+
+	void StatCache::invalidate()
+	{
+		std::lock_guard<std::mutex> guard(_this->mutex);
+		_this->entries.clear();
+	}
+
+	size_t StatCache::hits() const
+	{
+		std::lock_guard<std::mutex> guard(_this->mutex);
+		return _this->hits;
+	}
+
+	size_t StatCache::misses() const
+	{
+		std::lock_guard<std::mutex> guard(_this->mutex);
+		return _this->misses;
+	}
+
+}
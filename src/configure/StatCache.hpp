@@ -0,0 +1,61 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <ctime>
+#include <memory>
+
+namespace configure {
+
+	// Process wide cache of file status.
+	//
+	// Every query made during the configuration goes through this cache, so
+	// that the same path is stat'ed only once. Entries are kept until they
+	// are invalidated: code that modifies the filesystem (or runs a child
+	// process) must call invalidate(). Relative paths depend on the current
+	// directory and are never cached.
+	class StatCache
+	{
+	public:
+		typedef boost::filesystem::path path_t;
+
+		struct Status
+		{
+			bool exists;
+			bool is_regular_file;
+			bool is_directory;
+			std::time_t mtime;
+		};
+
+	private:
+		struct Impl;
+		std::unique_ptr<Impl> _this;
+
+	public:
+		StatCache();
+		~StatCache();
+
+		static StatCache& instance();
+
+	public:
+		Status status(path_t const& path);
+		bool exists(path_t const& path);
+		bool is_regular_file(path_t const& path);
+		bool is_directory(path_t const& path);
+
+		// Throws if the path does not exist.
+		std::time_t last_write_time(path_t const& path);
+
+	public:
+		// Forget about `path`, its parent directory and everything below it.
+		void invalidate(path_t const& path);
+
+		// Forget everything.
+		void invalidate();
+
+	public:
+		size_t hits() const;
+		size_t misses() const;
+	};
+
+}
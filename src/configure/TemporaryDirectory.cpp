@@ -1,6 +1,7 @@
 #include <configure/TemporaryDirectory.hpp>
 #include <configure/log.hpp>
 #include <configure/error.hpp>
+#include <configure/StatCache.hpp>
 
 namespace configure
 {
@@ -12,6 +13,7 @@ namespace configure
 	{
 		boost::filesystem::create_directories(_dir);
 		_dir = boost::filesystem::canonical(_dir);
+		StatCache::instance().invalidate(_dir);
 	}
 
 	TemporaryDirectory::~TemporaryDirectory()
@@ -19,6 +21,7 @@ namespace configure
 		try
 		{
 			boost::filesystem::remove_all(_dir);
+			StatCache::instance().invalidate(_dir);
 		}
 		catch (...)
 		{
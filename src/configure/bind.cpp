@@ -1,5 +1,7 @@
 #include "bind.hpp"
 
+#include "lua/State.hpp"
+
 namespace configure {
 
 	void bind(lua::State& state)
@@ -16,4 +18,17 @@ namespace configure {
 		bind_temporary_directory(state);
 	}
 
+	std::unique_ptr<lua::State> new_lua_state(std::string const& package_path)
+	{
+		std::unique_ptr<lua::State> res(new lua::State);
+		bind(*res);
+		res->global("configure_library_dir", package_path);
+		res->load(
+			"require 'package'\n"
+			"package.path = configure_library_dir\n"
+		);
+		res->forbid_globals();
+		return res;
+	}
+
 }
@@ -2,10 +2,17 @@
 
 #include "lua/fwd.hpp"
 
+#include <memory>
+#include <string>
+
 namespace configure {
 
 	void bind(lua::State& state);
 
+	// Create a bound lua state that loads modules from `package_path`
+	// (something like "/path/to/lib/?.lua") and forbids new globals.
+	std::unique_ptr<lua::State> new_lua_state(std::string const& package_path);
+
 	void bind_build(lua::State& state);
 	void bind_environ(lua::State& state);
 	void bind_filesystem(lua::State& state);
@@ -1,12 +1,15 @@
 #include <configure/bind.hpp>
 #include <configure/bind/path_utils.hpp>
+#include <configure/bind/environ_utils.hpp>
 
 #include <configure/Build.hpp>
 #include <configure/Rule.hpp>
 #include <configure/lua/State.hpp>
 #include <configure/lua/Type.hpp>
 #include <configure/Filesystem.hpp>
+#include <configure/Manifest.hpp>
 #include <configure/Platform.hpp>
+#include <configure/ProbeCache.hpp>
 
 #include <boost/filesystem/path.hpp>
 
@@ -98,6 +101,31 @@ namespace configure {
 		return 0;
 	}
 
+	static int Build_shared_probe(lua_State* state)
+	{
+		auto key = lua::Converter<std::string>::extract(state, 2);
+		if (!lua_isfunction(state, 3))
+			throw std::runtime_error("Expected a function as a second argument");
+		auto res = ProbeCache::instance().get(
+			key,
+			[=]() -> Environ::Value {
+				lua_pushvalue(state, 3);
+				lua::State::check_status(state, lua_pcall(state, 0, 1, 0));
+				auto value = lua::Converter<Environ::Value>::extract(state, -1);
+				lua_pop(state, 1);
+				return value;
+			});
+		lua::Converter<Environ::Value>::push(state, std::move(res));
+		return 1;
+	}
+
+	static int Build_add_written_file(lua_State* state)
+	{
+		Build& self = lua::Converter<std::reference_wrapper<Build>>::extract(state, 1);
+		self.manifest().add_written_file(utils::extract_path(state, 2));
+		return 0;
+	}
+
 	static int Build_configure(lua_State* state)
 	{
 		Build& self = lua::Converter<std::reference_wrapper<Build>>::extract(state, 1);
@@ -107,6 +135,7 @@ namespace configure {
 		fs::path dir;
 		fs::path build_dir = ".";
 		bool has_args = false;
+		bool independent = false;
 		lua_pushnil(state);
 		while (lua_next(state, 2))
 		{
@@ -117,6 +146,8 @@ namespace configure {
 				build_dir = utils::extract_path(state, -1);
 			else if (key == "args")
 				has_args = true;
+			else if (key == "independent")
+				independent = lua_toboolean(state, -1);
 			else
 				CONFIGURE_THROW(
 					error::InvalidArgument("Invalid key '" + key + "'")
@@ -130,6 +161,17 @@ namespace configure {
 
 		if (!dir.is_absolute())
 			dir = self.project_directory() / dir;
+		if (independent)
+		{
+			if (has_args)
+				CONFIGURE_THROW(
+					error::InvalidArgument(
+						"Independent sub-projects cannot receive arguments")
+				);
+			self.include_independent(dir, build_dir);
+			lua_pushnil(state);
+			return 1;
+		}
 		if (has_args)
 		{
 			luaL_checktype(state, 2, LUA_TTABLE);
@@ -155,6 +197,10 @@ namespace configure {
 		  // @tparam table args
 		  // @tparam Path args.directory relative path to the sub-project directory
 		  // @tparam[opt] args table Arguments for the configure function
+		  // @tparam[opt] bool args.independent Configure the sub-project in
+		  // its own lua state, concurrently with other independent
+		  // sub-projects, once the current project is configured (no
+		  // arguments allowed, returns nothing).
 		  // @returns The configuration function return value
 		  .def("include", &Build_configure)
 
@@ -278,6 +324,25 @@ namespace configure {
 		  // @function Build:path_option
 		  .def( "lazy_path_option", &Build_lazy_option<fs::path> )
 
+		  /// Compute a probe result once for all build directories.
+		  //
+		  // The result is stored in the user probe cache (see the
+		  // CONFIGURE_PROBE_CACHE_DIR environment variable), the key must
+		  // describe everything the result depends on.
+		  // @string key Unique key of the probe
+		  // @func fn Function called when the result is not cached
+		  // @return The cached or computed value
+		  // @function Build:shared_probe
+		  .def("shared_probe", &Build_shared_probe)
+
+		  /// Record a file written while configuring.
+		  //
+		  // The configuration runs again when the file is missing or changed,
+		  // since replaying the build graph does not write it.
+		  // @tparam Path path Absolute path of the file
+		  // @function Build:add_written_file
+		  .def("add_written_file", &Build_add_written_file)
+
 		  /// The host platform.
 		  // @treturn Platform
 		  // @function Build:host_platform
@@ -1,14 +1,18 @@
 #include <configure/bind.hpp>
 #include <configure/bind/path_utils.hpp>
 
+#include <configure/Build.hpp>
 #include <configure/Filesystem.hpp>
 #include <configure/lua/State.hpp>
 #include <configure/lua/Type.hpp>
 #include <configure/Node.hpp>
+#include <configure/StatCache.hpp>
 #include <configure/bind/path_utils.hpp>
 
 #include <boost/filesystem.hpp>
 
+#include <cstring>
+
 namespace fs = boost::filesystem;
 
 
@@ -53,9 +57,21 @@ namespace configure {
 			dir = arg;
 		else
 			dir = lua::Converter<fs::path>::extract(state, 2);
+		std::vector<std::string> excludes;
+		if (lua_type(state, 4) == LUA_TSTRING)
+			excludes.push_back(lua_tostring(state, 4));
+		else if (lua_istable(state, 4))
+		{
+			for (int i = 1, len = lua_rawlen(state, 4); i <= len; ++i)
+			{
+				lua_rawgeti(state, 4, i);
+				excludes.push_back(lua::Converter<std::string>::extract(state, -1));
+				lua_pop(state, 1);
+			}
+		}
 		if (char const* arg = lua_tostring(state, 3))
 		{
-			res = self.rglob(dir, arg);
+			res = self.rglob(dir, arg, excludes);
 		}
 
 		lua_createtable(state, res.size(), 0);
@@ -121,7 +137,7 @@ namespace configure {
 
 		if (!arg.empty())
 		{
-			auto res = self.which(arg);
+			auto res = self.find_program(arg);
 			if (res)
 				lua::Converter<fs::path>::push(state, *res);
 			else
@@ -154,7 +170,7 @@ namespace configure {
 		if (!src.is_absolute())
 			src = fs::current_path() / src;
 
-		if (!fs::exists(src))
+		if (!StatCache::instance().exists(src))
 			CONFIGURE_THROW(error::LuaError("Couldn't find the script path")
 			                << error::path(src));
 		lua::Converter<fs::path>::push(state, src);
@@ -190,16 +206,110 @@ namespace configure {
 		return 1;
 	}
 
+	static int fs_copy_files(lua_State* state)
+	{
+		Filesystem& self = lua::Converter<std::reference_wrapper<Filesystem>>::extract(state, 1);
+		if (!lua_istable(state, 2))
+			CONFIGURE_THROW(
+				error::LuaError("Expected a table of {src, dst} pairs")
+					<< error::lua_function("Filesystem::copy_files")
+			);
+		std::vector<std::pair<NodePtr, fs::path>> files;
+		for (int i = 1, len = lua_rawlen(state, 2); i <= len; ++i)
+		{
+			lua_rawgeti(state, 2, i);
+			lua_rawgeti(state, -1, 1);
+			lua_rawgeti(state, -2, 2);
+			NodePtr src;
+			if (NodePtr* arg = lua::Converter<NodePtr>::extract_ptr(state, -2))
+				src = *arg;
+			else
+				src = self.build().source_node(utils::extract_path(state, -2));
+			files.emplace_back(std::move(src), utils::extract_path(state, -1));
+			lua_pop(state, 3);
+		}
+		auto res = self.copy(files);
+		lua_createtable(state, res.size(), 0);
+		for (int i = 0, len = res.size(); i < len; ++i)
+		{
+			lua::Converter<NodePtr>::push(state, res[i]);
+			lua_rawseti(state, -2, i + 1);
+		}
+		return 1;
+	}
+
 	static int fs_create_directories(lua_State* state)
 	{
 		lua::Converter<std::reference_wrapper<Filesystem>>::extract(state, 1);
-		bool res = fs::create_directories(utils::extract_path(state, 2));
+		auto path = utils::extract_path(state, 2);
+		bool res = fs::create_directories(path);
+		StatCache::instance().invalidate(path);
 		lua::Converter<bool>::push(state, res);
 		return 1;
 	}
 
+	namespace {
+
+		enum class LuaWriter
+		{
+			open,   // io.open(path, mode)
+			output, // io.output(path)
+			remove, // os.remove(path)
+			rename, // os.rename(src, dst)
+		};
+
+		// Call the wrapped lua function (first upvalue) and forget about the
+		// paths it may have modified in the stat cache.
+		int call_lua_writer(lua_State* state)
+		{
+			auto kind = static_cast<LuaWriter>(
+			    lua_tointeger(state, lua_upvalueindex(2)));
+			std::vector<fs::path> paths;
+			if (lua_type(state, 1) == LUA_TSTRING)
+				paths.push_back(lua_tostring(state, 1));
+			if (kind == LuaWriter::rename && lua_type(state, 2) == LUA_TSTRING)
+				paths.push_back(lua_tostring(state, 2));
+			if (kind == LuaWriter::open)
+			{
+				char const* mode = luaL_optstring(state, 2, "r");
+				if (std::strpbrk(mode, "wa+") == nullptr)
+					paths.clear();
+			}
+
+			lua_pushvalue(state, lua_upvalueindex(1));
+			lua_insert(state, 1);
+			lua_call(state, lua_gettop(state) - 1, LUA_MULTRET);
+			for (auto& path: paths)
+				StatCache::instance().invalidate(fs::absolute(path));
+			return lua_gettop(state);
+		}
+
+		void wrap_lua_writer(lua_State* state,
+		                     char const* library,
+		                     char const* name,
+		                     LuaWriter kind)
+		{
+			lua_getglobal(state, library);
+			if (lua_istable(state, -1))
+			{
+				lua_getfield(state, -1, name);
+				lua_pushinteger(state, static_cast<lua_Integer>(kind));
+				lua_pushcclosure(state, &call_lua_writer, 2);
+				lua_setfield(state, -2, name);
+			}
+			lua_pop(state, 1);
+		}
+
+	}
+
 	void bind_filesystem(lua::State& state)
 	{
+		// Files written from lua must not be seen with a stale status.
+		wrap_lua_writer(state.ptr(), "io", "open", LuaWriter::open);
+		wrap_lua_writer(state.ptr(), "io", "output", LuaWriter::output);
+		wrap_lua_writer(state.ptr(), "os", "remove", LuaWriter::remove);
+		wrap_lua_writer(state.ptr(), "os", "rename", LuaWriter::rename);
+
 		/// Filesystem operations.
 		// @classmod Filesystem
 		lua::Type<Filesystem, std::reference_wrapper<Filesystem>>(state, "Filesystem")
@@ -210,9 +320,14 @@ namespace configure {
 			.def("glob", &fs_glob)
 
 			/// Find files recursively according to a glob pattern
+			//
+			// A pattern without `**` matches at any depth. Symbolic links to
+			// directories are not followed.
 			// @function Filesystem:rglob
 			// @tparam string|Path dir The base directory
-			// @string pattern A glob pattern
+			// @string pattern A glob pattern (supports `**` and `{a,b}`)
+			// @tparam[opt] string|table excludes Pattern(s) of files and
+			// directories to skip
 			// @return A list of @{Node}s
 			.def("rglob", &fs_rglob)
 
@@ -240,6 +355,12 @@ namespace configure {
 			// @treturn Node the target node
 			.def("copy", &fs_copy)
 
+			/// Generate a single rule that copy many files.
+			// @function Filesystem:copy_files
+			// @tparam table files A list of {src, dst} pairs
+			// @treturn table the target nodes
+			.def("copy_files", &fs_copy_files)
+
 			/// Return the current working directory
 			// @function Filesystem:cwd
 			// @treturn Path current directory
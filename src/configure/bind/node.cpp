@@ -10,6 +10,44 @@
 
 namespace fs = boost::filesystem;
 
+namespace configure { namespace lua {
+
+	// The address of this variable is the registry key of the node cache.
+	static char const node_cache_key = 0;
+
+	NodePtr& Converter<NodePtr>::push(lua_State* state, NodePtr const& node)
+	{
+		if (node == nullptr)
+			return UserdataConverter<NodePtr>::push(state, node);
+
+		if (lua_rawgetp(state, LUA_REGISTRYINDEX, &node_cache_key) != LUA_TTABLE)
+		{
+			lua_pop(state, 1);
+			lua_newtable(state);
+			lua_newtable(state);
+			lua_pushstring(state, "v");
+			lua_setfield(state, -2, "__mode");
+			lua_setmetatable(state, -2);
+			lua_pushvalue(state, -1);
+			lua_rawsetp(state, LUA_REGISTRYINDEX, &node_cache_key);
+		}
+
+		if (lua_rawgetp(state, -1, node.get()) == LUA_TUSERDATA)
+		{
+			lua_remove(state, -2);
+			return *extract_ptr(state, -1);
+		}
+		lua_pop(state, 1);
+
+		NodePtr& res = UserdataConverter<NodePtr>::push(state, node);
+		lua_pushvalue(state, -1);
+		lua_rawsetp(state, -3, node.get());
+		lua_remove(state, -2);
+		return res;
+	}
+
+}}
+
 namespace configure {
 
 	static int Node_property(lua_State* state)
@@ -2,6 +2,7 @@
 
 #include <configure/lua/State.hpp>
 #include <configure/lua/Type.hpp>
+#include <configure/StatCache.hpp>
 
 #include <boost/filesystem.hpp>
 
@@ -50,14 +51,14 @@ namespace configure {
 	static int Path_is_directory(lua_State* state)
 	{
 		auto& self = lua::Converter<fs::path>::extract(state, 1);
-		lua_pushboolean(state, fs::is_directory(self));
+		lua_pushboolean(state, StatCache::instance().is_directory(self));
 		return 1;
 	}
 
 	static int Path_exists(lua_State* state)
 	{
 		auto& self = lua::Converter<fs::path>::extract(state, 1);
-		lua_pushboolean(state, fs::exists(self));
+		lua_pushboolean(state, StatCache::instance().exists(self));
 		return 1;
 	}
 
@@ -1,18 +1,80 @@
 #include "commands.hpp"
 
+#include "commands/copy.hpp"
 #include "commands/extract.hpp"
 #include "commands/fetch.hpp"
 #include "commands/header_dependencies.hpp"
 #include "commands/lua_function.hpp"
+#include "commands/remove.hpp"
 #include "commands/touch.hpp"
 
 #include <fstream>
 
 namespace configure { namespace commands {
 
+	namespace {
+
+		// Read one argument per line, an empty line ends a command.
+		std::vector<std::string> read_batch_file(std::string const& path)
+		{
+			std::ifstream in(path);
+			if (!in)
+				throw std::runtime_error("Cannot open batch file '" + path + "'");
+			std::vector<std::string> res;
+			std::string line;
+			bool empty = true;
+			while (std::getline(in, line))
+			{
+				if (line.empty())
+				{
+					if (!empty)
+						res.push_back("--then");
+					empty = true;
+				}
+				else
+				{
+					res.push_back(line);
+					empty = false;
+				}
+			}
+			if (!res.empty() && res.back() == "--then")
+				res.pop_back();
+			return res;
+		}
+
+	}
+
+	void batch(std::vector<std::string> const& args)
+	{
+		std::vector<std::string> command;
+		for (auto it = args.begin(); ; ++it)
+		{
+			if (it == args.end() || *it == "--then")
+			{
+				// The first failure stops the batch.
+				if (!command.empty())
+					execute(command);
+				command.clear();
+				if (it == args.end())
+					break;
+			}
+			else
+				command.push_back(*it);
+		}
+	}
+
 	void execute(std::vector<std::string> const& args)
 	{
-		if (args[0] == "c-header-dependencies")
+		if (args[0] == "batch")
+		{
+			// batch CMD [ARGS]... [--then CMD [ARGS]...]...
+			// batch --file FILE
+			if (args.size() == 3 && args[1] == "--file")
+				batch(read_batch_file(args[2]));
+			else
+				batch({args.begin() + 1, args.end()});
+		}
+		else if (args[0] == "c-header-dependencies")
 		{
 			std::ofstream out(args[1]);
 			boost::filesystem::path source = args[2];
@@ -28,14 +90,76 @@ namespace configure { namespace commands {
 			header_dependencies(out, source, targets, include_directories);
 		}
 		else if (args[0] == "fetch")
-			fetch(args.at(1), args.at(2));
+		{
+			// fetch [--sha256 HEX] [--cache-dir DIR] URI DEST
+			std::string sha256;
+			boost::filesystem::path cache_dir;
+			size_t i = 1;
+			for (; i + 1 < args.size(); i += 2)
+			{
+				if (args[i] == "--sha256")
+					sha256 = args[i + 1];
+				else if (args[i] == "--cache-dir")
+					cache_dir = args[i + 1];
+				else
+					break;
+			}
+			fetch(args.at(i), args.at(i + 1), sha256, cache_dir);
+		}
 		else if (args[0] == "extract")
-			extract(args.at(1), args.at(2));
+		{
+			// extract [--strip-components N] ARCHIVE DEST
+			if (args.size() > 1 && args[1] == "--strip-components")
+				extract(args.at(3), args.at(4), std::stoul(args.at(2)));
+			else
+				extract(args.at(1), args.at(2));
+		}
+		else if (args[0] == "copy")
+		{
+			// copy [--hardlink] [--stamp FILE] SRC DST [SRC DST]...
+			size_t i = 1;
+			bool hardlink = (args.size() > i && args[i] == "--hardlink");
+			if (hardlink)
+				i += 1;
+			boost::filesystem::path stamp;
+			if (args.size() > i && args[i] == "--stamp")
+			{
+				stamp = args.at(i + 1);
+				i += 2;
+			}
+			if ((args.size() - i) % 2 != 0)
+				throw std::runtime_error("copy expects pairs of source and destination");
+			std::vector<copy_pair_t> files;
+			for (; i < args.size(); i += 2)
+				files.emplace_back(args[i], args[i + 1]);
+			copy(files, hardlink, stamp);
+		}
 		else if (args[0] == "touch")
-			touch(args.at(1));
+		{
+			// touch [--hash HASH] FILE
+			if (args.size() > 1 && args[1] == "--hash")
+				touch_stamp(args.at(3), args.at(2));
+			else
+				touch(args.at(1));
+		}
+		else if (args[0] == "remove")
+		{
+			// remove PATH...
+			remove(std::vector<boost::filesystem::path>(args.begin() + 1, args.end()));
+		}
 		else if (args[0] == "lua-function")
-			lua_function(
-			  args.at(1), args.at(2), {args.begin() + 3, args.end()});
+		{
+			// lua-function SCRIPT FUNCTION [ARGS]... [--next [ARGS]...]...
+			std::vector<std::vector<std::string>> arg_sets(1);
+			for (size_t i = 3; i < args.size(); ++i)
+			{
+				if (args[i] == "--next")
+					arg_sets.emplace_back();
+				else
+					arg_sets.back().push_back(args[i]);
+			}
+			lua_function(args.at(1), args.at(2), arg_sets, lua_cache_directory());
+		}
 		else
 			throw std::runtime_error("Unknown command '" + args[0] + "'");
 	}
@@ -7,4 +7,7 @@ namespace configure { namespace commands {
 
 	void execute(std::vector<std::string> const& args);
 
+	// Execute commands separated by "--then" in order, until one fails.
+	void batch(std::vector<std::string> const& args);
+
 }}
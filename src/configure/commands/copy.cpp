@@ -0,0 +1,187 @@
+#include "copy.hpp"
+#include "touch.hpp"
+
+#include <configure/error.hpp>
+#include <configure/log.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+#ifdef __linux__
+# include <linux/fs.h>
+# include <sys/ioctl.h>
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+# define CONFIGURE_HAS_COPY_FILE_RANGE
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace configure { namespace commands {
+
+	namespace {
+
+		bool same_content(fs::path const& src, fs::path const& dst)
+		{
+			boost::system::error_code ec;
+			if (!fs::is_regular_file(dst, ec) ||
+			    fs::file_size(src) != fs::file_size(dst, ec) || ec)
+				return false;
+			std::ifstream a(src.string(), std::ios::binary);
+			std::ifstream b(dst.string(), std::ios::binary);
+			char buf_a[65536], buf_b[65536];
+			while (a && b)
+			{
+				a.read(buf_a, sizeof(buf_a));
+				b.read(buf_b, sizeof(buf_b));
+				if (a.gcount() != b.gcount() ||
+				    std::memcmp(buf_a, buf_b, a.gcount()) != 0)
+					return false;
+			}
+			return a.eof() && b.eof();
+		}
+
+#ifndef _WIN32
+		struct FileDescriptor
+		{
+			int fd;
+			explicit FileDescriptor(int fd) : fd(fd) {}
+			~FileDescriptor() { if (fd != -1) ::close(fd); }
+		};
+
+		// Fill `out` with the content of `in`, sharing the extents when the
+		// filesystem supports it.
+		void copy_content(int in, int out, off_t size)
+		{
+# ifdef __linux__
+			if (::ioctl(out, FICLONE, in) == 0)
+				return;
+# endif
+			off_t copied = 0;
+# ifdef CONFIGURE_HAS_COPY_FILE_RANGE
+			while (copied < size)
+			{
+				auto res = ::copy_file_range(in, nullptr, out, nullptr,
+				                             size - copied, 0);
+				if (res <= 0)
+					break;
+				copied += res;
+			}
+			if (copied >= size)
+				return;
+# endif
+			// Not supported (or across filesystems on old kernels).
+			if (::lseek(in, copied, SEEK_SET) < 0 ||
+			    ::lseek(out, copied, SEEK_SET) < 0)
+				CONFIGURE_THROW_SYSTEM_ERROR("lseek()");
+			char buffer[65536];
+			while (true)
+			{
+				auto res = ::read(in, buffer, sizeof(buffer));
+				if (res < 0)
+				{
+					if (errno == EINTR) continue;
+					CONFIGURE_THROW_SYSTEM_ERROR("read()");
+				}
+				if (res == 0)
+					break;
+				for (ssize_t written = 0; written < res;)
+				{
+					auto w = ::write(out, buffer + written, res - written);
+					if (w < 0)
+					{
+						if (errno == EINTR) continue;
+						CONFIGURE_THROW_SYSTEM_ERROR("write()");
+					}
+					written += w;
+				}
+			}
+		}
+#endif
+
+		void copy_to(fs::path const& src, fs::path const& tmp, bool hardlink)
+		{
+#ifdef _WIN32
+			if (hardlink)
+			{
+				boost::system::error_code ec;
+				fs::create_hard_link(src, tmp, ec);
+				if (!ec)
+					return;
+			}
+			fs::copy_file(src, tmp, fs::copy_option::overwrite_if_exists);
+#else
+			if (hardlink && ::link(src.c_str(), tmp.c_str()) == 0)
+				return;
+			FileDescriptor in(::open(src.c_str(), O_RDONLY | O_CLOEXEC));
+			if (in.fd < 0)
+				CONFIGURE_THROW(CONFIGURE_SYSTEM_ERROR("open()") << error::path(src));
+			struct stat st;
+			if (::fstat(in.fd, &st) != 0)
+				CONFIGURE_THROW(CONFIGURE_SYSTEM_ERROR("fstat()") << error::path(src));
+			FileDescriptor out(::open(tmp.c_str(),
+			                          O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+			                          st.st_mode & 07777));
+			if (out.fd < 0)
+				CONFIGURE_THROW(CONFIGURE_SYSTEM_ERROR("open()") << error::path(tmp));
+			copy_content(in.fd, out.fd, st.st_size);
+#endif
+		}
+
+		// Returns whether `dst` was written.
+		bool copy_file(fs::path const& src, fs::path const& dst, bool hardlink)
+		{
+			boost::system::error_code ec;
+			if (fs::equivalent(src, dst, ec))
+				return false; // Already hard linked
+			if (same_content(src, dst))
+			{
+				log::debug("Keeping", dst, "(same content as", src, ")");
+				return false;
+			}
+			log::debug("Copying", src, "to", dst);
+			fs::create_directories(dst.parent_path());
+			// Concurrent copies to the same destination never see a partial
+			// file.
+			auto tmp = dst.parent_path() /
+				fs::unique_path("." + dst.filename().string() + ".%%%%%%%%.tmp");
+			try {
+				copy_to(src, tmp, hardlink);
+				fs::rename(tmp, dst);
+			} catch (...) {
+				fs::remove(tmp, ec);
+				throw;
+			}
+			return true;
+		}
+
+	}
+
+	void copy(std::vector<copy_pair_t> const& files,
+	          bool hardlink,
+	          fs::path const& stamp)
+	{
+		for (auto& pair: files)
+		{
+			auto dst = fs::absolute(pair.second);
+			// Make sees the target as up to date.
+			if (!copy_file(pair.first, dst, hardlink) && stamp.empty())
+				touch(dst);
+		}
+		if (!stamp.empty())
+		{
+			fs::create_directories(fs::absolute(stamp).parent_path());
+			touch(stamp);
+		}
+	}
+
+}}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace configure { namespace commands {
+
+	typedef std::pair<boost::filesystem::path, boost::filesystem::path>
+		copy_pair_t;
+
+	// Copy each source to its destination. The copy is cloned or hard linked
+	// (when `hardlink` is set) when the filesystem allows it.
+	//
+	// Destinations that already have the right content are left alone, so
+	// that nothing depending on them gets rebuilt. The `stamp` file, when
+	// given, is touched once everything is copied. Otherwise the unchanged
+	// destinations are touched, which only makes sense when they are the
+	// targets of the build rule.
+	void copy(std::vector<copy_pair_t> const& files,
+	          bool hardlink = false,
+	          boost::filesystem::path const& stamp = {});
+
+}}
@@ -1,48 +1,674 @@
 #include "extract.hpp"
 
+#include <configure/error.hpp>
 #include <configure/log.hpp>
-#include <configure/Process.hpp>
+#include <configure/utils/path.hpp>
 
-#include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/restrict.hpp>
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 106300
+# include <boost/iostreams/filter/lzma.hpp>
+#endif
 
-namespace configure { namespace commands {
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
 
-	void extract(boost::filesystem::path const& tarball,
-	             boost::filesystem::path const& dest_dir)
-	{
-		auto ext = tarball.extension().string();
-		if (ext == ".tgz" ||
-		    boost::ends_with(tarball.string(), ".tar.gz") ||
-		    boost::ends_with(tarball.string(), ".tar.bz2"))
-		{
-			auto tarball_resolved = boost::filesystem::canonical(tarball);
-			tarball_resolved.make_preferred();
-			auto dest_dir_resolved = boost::filesystem::canonical(dest_dir);
-			dest_dir_resolved.make_preferred();
-#ifdef _WIN32
-			tarball_resolved = boost::replace_all_copy(tarball_resolved.string(), "\\", "/");
-			dest_dir_resolved = boost::replace_all_copy(dest_dir_resolved.string(), "\\", "/");
+#ifndef _WIN32
+# include <sys/stat.h>
 #endif
-			Process::Options options;
-			Process::check_call({"tar", "-xf", tarball_resolved.string(), "-C",
-			                     dest_dir_resolved.string(), "--strip-components=1",
-#ifdef _WIN32
-			                     // We force tar to ignore colon in file names (assuming gnu tar)
-			                     "--force-local"
+
+namespace fs = boost::filesystem;
+namespace io = boost::iostreams;
+
+namespace configure { namespace commands {
+
+	namespace {
+
+		// Files are written by chunks of that size.
+		std::streamsize const buffer_size = 1 << 20;
+
+		[[noreturn]] void invalid_archive(fs::path const& archive, std::string const& msg)
+		{
+			CONFIGURE_THROW(
+				error::InvalidArgument("Invalid archive: " + msg)
+					<< error::path(archive)
+			);
+		}
+
+		void read_exact(std::istream& in, char* data, std::streamsize size)
+		{
+			in.read(data, size);
+			if (in.gcount() != size)
+				CONFIGURE_THROW(error::RuntimeError("Unexpected end of archive"));
+		}
+
+		std::string read_string(std::istream& in, uint64_t size)
+		{
+			std::string res(size, '\0');
+			read_exact(in, &res[0], size);
+			return res;
+		}
+
+		void skip(std::istream& in, uint64_t size)
+		{
+			char buffer[4096];
+			while (size > 0)
+			{
+				auto chunk = std::min<uint64_t>(size, sizeof(buffer));
+				read_exact(in, buffer, chunk);
+				size -= chunk;
+			}
+		}
+
+		// Returns the destination of a member relative to the extract
+		// directory, or an empty path when every component is stripped.
+		fs::path member_path(std::string const& name, unsigned strip)
+		{
+			std::vector<std::string> parts;
+			boost::split(parts, name, boost::is_any_of("/\\"));
+			fs::path res;
+			unsigned stripped = 0;
+			for (auto& part: parts)
+			{
+				if (part.empty() || part == ".")
+					continue;
+				if (part == "..")
+					CONFIGURE_THROW(
+						error::InvalidPath("Archive member outside of the extract directory")
+							<< error::path(name)
+					);
+				if (stripped < strip)
+					stripped += 1;
+				else
+					res /= part;
+			}
+			return res;
+		}
+
+		void remove_existing(fs::path const& path)
+		{
+			boost::system::error_code ec;
+			if (!fs::is_directory(fs::symlink_status(path, ec)))
+				fs::remove(path, ec);
+		}
+
+		void write_file(fs::path const& path,
+		                std::istream& in,
+		                uint64_t size,
+		                std::vector<char>& buffer,
+		                boost::crc_32_type* crc)
+		{
+			remove_existing(path);
+			std::ofstream out(path.string(), std::ios::binary | std::ios::trunc);
+			if (!out)
+				CONFIGURE_THROW(
+					error::SystemError("Cannot open file for writing")
+						<< error::path(path)
+				);
+			while (size > 0)
+			{
+				auto chunk = std::min<uint64_t>(size, buffer.size());
+				read_exact(in, buffer.data(), chunk);
+				if (crc != nullptr)
+					crc->process_bytes(buffer.data(), chunk);
+				out.write(buffer.data(), chunk);
+				size -= chunk;
+			}
+			out.close();
+			if (!out)
+				CONFIGURE_THROW(
+					error::SystemError("Cannot write file") << error::path(path)
+				);
+		}
+
+		void set_metadata(fs::path const& path, unsigned mode, std::time_t mtime)
+		{
+#ifndef _WIN32
+			if (mode != 0)
+				::chmod(path.c_str(), mode & 0777);
 #endif
-			                     },
-			                    options);
+			boost::system::error_code ec;
+			fs::last_write_time(path, mtime, ec);
+		}
+
+		// Symbolic links are created once the other members are written, so
+		// that no member is written through a link of the archive.
+		struct Symlink
+		{
+			std::string target;
+			fs::path    path;
+		};
+
+		// Throws when the link `path` to `target` would point outside of
+		// `root`. Only leading ".." components are accepted, they are
+		// resolved from the real directory of the link.
+		void check_symlink(fs::path const& root,
+		                   fs::path const& path,
+		                   std::string const& target)
+		{
+			auto invalid = [&] {
+				CONFIGURE_THROW(
+					error::InvalidPath(
+						"Archive link to '" + target + "' outside of the extract directory"
+					) << error::path(path)
+				);
+			};
+			auto directory = fs::canonical(path.parent_path());
+			if (target.empty() || target[0] == '/' || target[0] == '\\' ||
+			    fs::path(target).has_root_name() ||
+			    !utils::starts_with(directory, root))
+				invalid();
+			size_t depth = 0;
+			for (auto& part: utils::relative_path(directory, root))
+				if (part != ".")
+					depth += 1;
+			std::vector<std::string> parts;
+			boost::split(parts, target, boost::is_any_of("/\\"));
+			bool descending = false;
+			for (auto& part: parts)
+			{
+				if (part.empty() || part == ".")
+					continue;
+				if (part != "..")
+					descending = true;
+				else if (descending || depth == 0)
+					invalid();
+				else
+					depth -= 1;
+			}
+		}
+
+		void create_symlinks(fs::path const& dest_dir, std::vector<Symlink> const& links)
+		{
+			auto root = fs::canonical(dest_dir);
+			for (auto& link: links)
+			{
+				fs::create_directories(link.path.parent_path());
+				check_symlink(root, link.path, link.target);
+				remove_existing(link.path);
+				fs::create_symlink(link.target, link.path);
+			}
+		}
+
+		///////////////////////////////////////////////////////////////////////
+		// tar
+
+		uint64_t parse_number(char const* field, size_t size)
+		{
+			uint64_t res = 0;
+			if (static_cast<unsigned char>(field[0]) & 0x80)
+			{
+				// GNU base-256 encoding used for large values.
+				res = static_cast<unsigned char>(field[0]) & 0x7f;
+				for (size_t i = 1; i < size; ++i)
+					res = (res << 8) | static_cast<unsigned char>(field[i]);
+				return res;
+			}
+			size_t i = 0;
+			while (i < size && (field[i] == ' ' || field[i] == '\0'))
+				i += 1;
+			for (; i < size && field[i] >= '0' && field[i] <= '7'; ++i)
+				res = (res << 3) | static_cast<uint64_t>(field[i] - '0');
+			return res;
+		}
+
+		std::string parse_string(char const* field, size_t size)
+		{ return std::string(field, ::strnlen(field, size)); }
+
+		bool is_zero_block(char const* block)
+		{ return std::all_of(block, block + 512, [](char c) { return c == '\0'; }); }
+
+		bool check_header(char const* header)
+		{
+			uint64_t sum = 0;
+			for (size_t i = 0; i < 512; ++i)
+				sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(header[i]);
+			return sum == parse_number(header + 148, 8);
+		}
+
+		// Records are "<length> <key>=<value>\n".
+		void parse_pax(std::string const& data, std::map<std::string, std::string>& res)
+		{
+			size_t pos = 0;
+			while (pos < data.size())
+			{
+				auto space = data.find(' ', pos);
+				if (space == std::string::npos)
+					break;
+				auto length = std::stoul(data.substr(pos, space - pos));
+				if (length == 0 || pos + length > data.size())
+					break;
+				auto record = data.substr(space + 1, pos + length - space - 2);
+				auto eq = record.find('=');
+				if (eq != std::string::npos)
+					res[record.substr(0, eq)] = record.substr(eq + 1);
+				pos += length;
+			}
+		}
+
+		void extract_tar(fs::path const& archive,
+		                 std::istream& in,
+		                 fs::path const& dest_dir,
+		                 unsigned strip)
+		{
+			std::vector<char> buffer(buffer_size);
+			char header[512];
+			std::string long_name, long_link;
+			std::map<std::string, std::string> pax;
+			std::vector<Symlink> links;
+			while (true)
+			{
+				in.read(header, sizeof(header));
+				if (in.gcount() == 0)
+					break; // Missing end of archive blocks
+				if (in.gcount() != sizeof(header))
+					invalid_archive(archive, "truncated header");
+				if (is_zero_block(header))
+					break;
+				if (!check_header(header))
+					invalid_archive(archive, "bad header checksum");
+
+				char type = header[156];
+				uint64_t size = parse_number(header + 124, 12);
+				uint64_t padding = (512 - size % 512) % 512;
+				if (type == 'L' || type == 'K' || type == 'x' || type == 'g')
+				{
+					auto data = read_string(in, size);
+					skip(in, padding);
+					if (type == 'L')
+						long_name = data.c_str();
+					else if (type == 'K')
+						long_link = data.c_str();
+					else if (type == 'x')
+						parse_pax(data, pax);
+					continue;
+				}
+
+				std::string name = parse_string(header, 100);
+				std::string link = parse_string(header + 157, 100);
+				std::string prefix = parse_string(header + 345, 155);
+				// Only POSIX headers have a prefix, GNU ones use "ustar  ".
+				if (std::memcmp(header + 257, "ustar", 6) == 0 && !prefix.empty())
+					name = prefix + "/" + name;
+				if (!long_name.empty())
+					name = long_name;
+				if (!long_link.empty())
+					link = long_link;
+				std::time_t mtime = parse_number(header + 136, 12);
+				if (pax.count("path")) name = pax["path"];
+				if (pax.count("linkpath")) link = pax["linkpath"];
+				if (pax.count("size"))
+				{
+					size = std::stoull(pax["size"]);
+					padding = (512 - size % 512) % 512;
+				}
+				if (pax.count("mtime")) mtime = std::stod(pax["mtime"]);
+				long_name.clear();
+				long_link.clear();
+				pax.clear();
+
+				auto relative_path = member_path(name, strip);
+				if (relative_path.empty())
+				{
+					skip(in, size + padding);
+					continue;
+				}
+				auto path = dest_dir / relative_path;
+				unsigned mode = parse_number(header + 100, 8);
+				switch (type)
+				{
+				case '\0':
+				case '0':
+				case '7':
+					fs::create_directories(path.parent_path());
+					write_file(path, in, size, buffer, nullptr);
+					set_metadata(path, mode, mtime);
+					size = 0;
+					break;
+				case '5':
+					fs::create_directories(path);
+					break;
+				case '2':
+					links.push_back(Symlink{link, path});
+					break;
+				case '1':
+				{
+					auto target = dest_dir / member_path(link, strip);
+					fs::create_directories(path.parent_path());
+					remove_existing(path);
+					boost::system::error_code ec;
+					fs::create_hard_link(target, path, ec);
+					if (ec)
+						fs::copy_file(target, path);
+					break;
+				}
+				default:
+					log::debug("Ignoring archive member", name, "of type", type);
+				}
+				skip(in, size + padding);
+			}
+			create_symlinks(dest_dir, links);
+		}
+
+		///////////////////////////////////////////////////////////////////////
+		// zip
+
+		uint16_t read16(char const* p)
+		{
+			auto u = reinterpret_cast<unsigned char const*>(p);
+			return u[0] | (u[1] << 8);
+		}
+
+		uint32_t read32(char const* p)
+		{ return read16(p) | (static_cast<uint32_t>(read16(p + 2)) << 16); }
+
+		uint64_t read64(char const* p)
+		{ return read32(p) | (static_cast<uint64_t>(read32(p + 4)) << 32); }
+
+		std::time_t dos_time(uint16_t time, uint16_t date)
+		{
+			std::tm tm;
+			std::memset(&tm, 0, sizeof(tm));
+			tm.tm_sec = (time & 0x1f) * 2;
+			tm.tm_min = (time >> 5) & 0x3f;
+			tm.tm_hour = time >> 11;
+			tm.tm_mday = date & 0x1f;
+			tm.tm_mon = ((date >> 5) & 0x0f) - 1;
+			tm.tm_year = (date >> 9) + 80;
+			tm.tm_isdst = -1;
+			return std::mktime(&tm);
+		}
+
+		struct ZipEntry
+		{
+			std::string name;
+			fs::path    path;
+			uint16_t    method;
+			uint32_t    crc;
+			uint64_t    compressed_size;
+			uint64_t    size;
+			uint64_t    offset;
+			unsigned    mode;
+			std::time_t mtime;
+
+			bool is_directory() const
+			{ return !name.empty() && (name.back() == '/' || name.back() == '\\'); }
+
+			bool is_symlink() const
+			{ return (mode & 0170000) == 0120000; }
+		};
+
+		std::vector<ZipEntry> read_zip_directory(fs::path const& archive)
+		{
+			std::ifstream in(archive.string(), std::ios::binary);
+			if (!in)
+				CONFIGURE_THROW(
+					error::FileNotFound("Cannot open archive") << error::path(archive)
+				);
+			in.seekg(0, std::ios::end);
+			uint64_t file_size = in.tellg();
+
+			// The end of central directory record is followed by a comment
+			// of at most 64K.
+			std::vector<char> tail(std::min<uint64_t>(file_size, 22 + 0xffff));
+			in.seekg(file_size - tail.size());
+			read_exact(in, tail.data(), tail.size());
+			if (tail.size() < 22)
+				invalid_archive(archive, "not a zip file");
+			size_t eocd = tail.size() - 22;
+			while (read32(&tail[eocd]) != 0x06054b50)
+			{
+				if (eocd == 0)
+					invalid_archive(archive, "not a zip file");
+				eocd -= 1;
+			}
+			uint64_t count = read16(&tail[eocd + 10]);
+			uint64_t directory_size = read32(&tail[eocd + 12]);
+			uint64_t directory_offset = read32(&tail[eocd + 16]);
+			if (count == 0xffff || directory_size == 0xffffffff ||
+			    directory_offset == 0xffffffff)
+			{
+				if (eocd < 20 || read32(&tail[eocd - 20]) != 0x07064b50)
+					invalid_archive(archive, "missing zip64 locator");
+				char record[56];
+				in.seekg(read64(&tail[eocd - 20 + 8]));
+				read_exact(in, record, sizeof(record));
+				if (read32(record) != 0x06064b50)
+					invalid_archive(archive, "bad zip64 record");
+				count = read64(record + 32);
+				directory_size = read64(record + 40);
+				directory_offset = read64(record + 48);
+			}
+
+			std::vector<char> directory(directory_size);
+			in.seekg(directory_offset);
+			read_exact(in, directory.data(), directory.size());
+			std::vector<ZipEntry> res;
+			size_t pos = 0;
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				if (pos + 46 > directory.size() ||
+				    read32(&directory[pos]) != 0x02014b50)
+					invalid_archive(archive, "bad central directory");
+				char const* header = &directory[pos];
+				uint16_t name_size = read16(header + 28);
+				uint16_t extra_size = read16(header + 30);
+				uint16_t comment_size = read16(header + 32);
+				if (pos + 46 + name_size + extra_size + comment_size > directory.size())
+					invalid_archive(archive, "bad central directory");
+				if (read16(header + 8) & 1)
+					CONFIGURE_THROW(
+						error::InvalidArgument("Encrypted zip members are not supported")
+							<< error::path(archive)
+					);
+				ZipEntry entry;
+				entry.name.assign(header + 46, name_size);
+				entry.method = read16(header + 10);
+				entry.mtime = dos_time(read16(header + 12), read16(header + 14));
+				entry.crc = read32(header + 16);
+				entry.compressed_size = read32(header + 20);
+				entry.size = read32(header + 24);
+				entry.offset = read32(header + 42);
+				// Unix permissions are stored when the member was made on Unix.
+				entry.mode = (read16(header + 4) >> 8) == 3 ?
+					read32(header + 38) >> 16 : 0;
+
+				char const* extra = header + 46 + name_size;
+				char const* extra_end = extra + extra_size;
+				while (extra + 4 <= extra_end)
+				{
+					uint16_t id = read16(extra);
+					char const* field = extra + 4;
+					char const* field_end = std::min(field + read16(extra + 2), extra_end);
+					if (id == 0x0001) // Zip64 sizes and offset
+					{
+						for (uint64_t* value: {&entry.size, &entry.compressed_size, &entry.offset})
+						{
+							if (*value != 0xffffffff || field + 8 > field_end)
+								continue;
+							*value = read64(field);
+							field += 8;
+						}
+					}
+					extra = field_end;
+				}
+				res.push_back(std::move(entry));
+				pos += 46 + name_size + extra_size + comment_size;
+			}
+			return res;
+		}
+
+		void open_zip_entry(fs::path const& archive,
+		                    ZipEntry const& entry,
+		                    io::filtering_istream& in)
+		{
+			char header[30];
+			{
+				std::ifstream in(archive.string(), std::ios::binary);
+				in.seekg(entry.offset);
+				read_exact(in, header, sizeof(header));
+			}
+			if (read32(header) != 0x04034b50)
+				invalid_archive(archive, "bad local header for " + entry.name);
+			uint64_t data_offset = entry.offset + sizeof(header) +
+				read16(header + 26) + read16(header + 28);
+
+			if (entry.method == 8)
+			{
+				io::zlib_params params;
+				params.noheader = true; // Raw deflate stream
+				in.push(io::zlib_decompressor(params, buffer_size));
+			}
+			else if (entry.method != 0)
+				CONFIGURE_THROW(
+					error::InvalidArgument(
+						"Unsupported compression method " +
+						std::to_string(entry.method) + " for " + entry.name
+					) << error::path(archive)
+				);
+			in.push(
+				io::restrict(
+					io::file_source(archive.string(), std::ios::binary),
+					data_offset,
+					entry.compressed_size
+				),
+				buffer_size
+			);
+			in.exceptions(std::ios::badbit);
+		}
+
+		void extract_zip_entry(fs::path const& archive,
+		                       ZipEntry const& entry,
+		                       std::vector<char>& buffer)
+		{
+			io::filtering_istream in;
+			open_zip_entry(archive, entry, in);
+			boost::crc_32_type crc;
+			write_file(entry.path, in, entry.size, buffer, &crc);
+			if (crc.checksum() != entry.crc)
+				invalid_archive(archive, "CRC mismatch for " + entry.name);
+			set_metadata(entry.path, entry.mode, entry.mtime);
 		}
-		else if (ext == ".zip")
+
+		void extract_zip(fs::path const& archive,
+		                 fs::path const& dest_dir,
+		                 unsigned strip)
 		{
-			Process::Options options;
-			Process::check_call({"unzip", "-o", tarball.string(), "-d",
-			                     dest_dir.string()},
-			                    options);
+			auto entries = read_zip_directory(archive);
+			std::vector<ZipEntry const*> files;
+			std::vector<ZipEntry const*> symlinks;
+			for (auto& entry: entries)
+			{
+				auto relative_path = member_path(entry.name, strip);
+				if (relative_path.empty())
+					continue;
+				entry.path = dest_dir / relative_path;
+				if (entry.is_directory())
+					fs::create_directories(entry.path);
+				else if (entry.is_symlink())
+					symlinks.push_back(&entry);
+				else
+				{
+					fs::create_directories(entry.path.parent_path());
+					files.push_back(&entry);
+				}
+			}
+
+			// Members are independent, the biggest ones are started first.
+			std::sort(
+				files.begin(),
+				files.end(),
+				[](ZipEntry const* a, ZipEntry const* b) { return a->size > b->size; }
+			);
+			unsigned jobs = std::max(1u, std::min({
+				8u,
+				std::thread::hardware_concurrency(),
+				static_cast<unsigned>(files.size()),
+			}));
+			std::atomic<size_t> next(0);
+			std::mutex mutex;
+			std::exception_ptr error;
+			auto worker = [&] {
+				std::vector<char> buffer(buffer_size);
+				for (size_t i = next++; i < files.size(); i = next++)
+				{
+					try { extract_zip_entry(archive, *files[i], buffer); }
+					catch (...) {
+						std::lock_guard<std::mutex> guard(mutex);
+						if (!error)
+							error = std::current_exception();
+						next = files.size();
+					}
+				}
+			};
+			std::vector<std::thread> threads;
+			for (unsigned i = 1; i < jobs; ++i)
+				threads.emplace_back(worker);
+			worker();
+			for (auto& thread: threads)
+				thread.join();
+			if (error)
+				std::rethrow_exception(error);
+
+			std::vector<Symlink> links;
+			for (auto entry: symlinks)
+			{
+				io::filtering_istream in;
+				open_zip_entry(archive, *entry, in);
+				links.push_back(Symlink{read_string(in, entry->size), entry->path});
+			}
+			create_symlinks(dest_dir, links);
 		}
-		else
-			throw std::runtime_error("Unknown tarball extension '" + ext + "'");
+
+	}
+
+	void extract(boost::filesystem::path const& tarball,
+	             boost::filesystem::path const& dest_dir,
+	             boost::optional<unsigned> strip_components)
+	{
+		auto name = boost::to_lower_copy(tarball.filename().string());
+		log::debug("Extracting", tarball, "into", dest_dir);
+		fs::create_directories(dest_dir);
+		if (boost::ends_with(name, ".zip"))
+			return extract_zip(tarball, dest_dir, strip_components.get_value_or(0));
+
+		io::filtering_istream in;
+		if (boost::ends_with(name, ".tar.gz") || boost::ends_with(name, ".tgz"))
+			in.push(io::gzip_decompressor(io::gzip::default_window_bits, buffer_size));
+		else if (boost::ends_with(name, ".tar.bz2") || boost::ends_with(name, ".tbz2"))
+			in.push(io::bzip2_decompressor(false, buffer_size));
+#if BOOST_VERSION >= 106300
+		else if (boost::ends_with(name, ".tar.xz") || boost::ends_with(name, ".txz"))
+			in.push(io::lzma_decompressor(io::lzma_params(), buffer_size));
+#endif
+		else if (!boost::ends_with(name, ".tar"))
+			CONFIGURE_THROW(
+				error::InvalidArgument("Unknown archive extension")
+					<< error::path(tarball)
+			);
+		io::file_source source(tarball.string(), std::ios::binary);
+		if (!source.is_open())
+			CONFIGURE_THROW(
+				error::FileNotFound("Cannot open archive") << error::path(tarball)
+			);
+		in.push(source, buffer_size);
+		// Report decompression errors instead of a truncated archive.
+		in.exceptions(std::ios::badbit);
+		extract_tar(tarball, in, dest_dir, strip_components.get_value_or(1));
 	}
 
 }}
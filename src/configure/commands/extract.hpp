@@ -1,10 +1,16 @@
 #pragma once
 
 #include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
 
 namespace configure { namespace commands {
 
+	// Extract a tar (optionally compressed with gzip, bzip2 or xz) or a zip
+	// archive into `dest_dir`. The first `strip_components` path components
+	// of each member are removed, it defaults to 1 for tarballs and 0 for
+	// zip files.
 	void extract(boost::filesystem::path const& tarball,
-	             boost::filesystem::path const& dest_dir);
+	             boost::filesystem::path const& dest_dir,
+	             boost::optional<unsigned> strip_components = boost::none);
 
 }}
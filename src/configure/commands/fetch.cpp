@@ -3,31 +3,103 @@
 #include <configure/Filesystem.hpp>
 #include <configure/ShellCommand.hpp>
 #include <configure/error.hpp>
+#include <configure/log.hpp>
 #include <configure/Process.hpp>
+#include <configure/utils/sha256.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 
 namespace configure { namespace commands {
 
 	namespace fs = boost::filesystem;
 
-	void fetch(std::string const& uri, boost::filesystem::path const& dest)
+	namespace {
+
+		void download(std::string const& uri, fs::path const& dest)
+		{
+			if (boost::starts_with(uri, "file://"))
+			{
+				fs::copy_file(uri.substr(7), dest,
+				              fs::copy_option::overwrite_if_exists);
+				return;
+			}
+			ShellCommand cmd;
+			if (auto wget = Filesystem::which("wget"))
+				cmd.append(*wget, "--no-check-certificate", uri, "-O", dest);
+			else if (auto curl = Filesystem::which("curl"))
+				cmd.append(*curl, "-L", uri, "-o", dest);
+			else if (auto powershell = Filesystem::which("powershell.exe"))
+				cmd.append(*powershell, "-command",
+					       "(new-object System.Net.WebClient).DownloadFile('" +
+					         uri + "', '" + dest.string() + "')");
+			else
+				CONFIGURE_THROW(
+					error::FileNotFound("Couldn't find any download program")
+					<< error::help("Please install curl or wget")
+				);
+
+			Process::Options options;
+			Process::check_call(cmd.dump(), options);
+		}
+
+		// Download next to `dest` and rename when the checksum matches, so
+		// that `dest` is either missing or complete.
+		void download_verified(std::string const& uri,
+		                       fs::path const& dest,
+		                       std::string const& sha256)
+		{
+			fs::create_directories(dest.parent_path());
+			auto tmp = dest.parent_path() /
+				fs::unique_path("." + dest.filename().string() + ".%%%%%%%%.part");
+			try {
+				download(uri, tmp);
+				if (!sha256.empty())
+				{
+					auto checksum = utils::sha256_file(tmp);
+					if (checksum != sha256)
+						CONFIGURE_THROW(
+							error::RuntimeError(
+								"Checksum mismatch for '" + uri + "': expected " +
+								sha256 + ", got " + checksum
+							) << error::path(dest)
+						);
+				}
+				fs::rename(tmp, dest);
+			} catch (...) {
+				boost::system::error_code ec;
+				fs::remove(tmp, ec);
+				throw;
+			}
+		}
+
+	}
+
+	void fetch(std::string const& uri,
+	           boost::filesystem::path const& relative_dest,
+	           std::string const& sha256,
+	           boost::filesystem::path const& cache_dir)
 	{
-		ShellCommand cmd;
-		if (auto wget = Filesystem::which("wget"))
-			cmd.append(*wget, "--no-check-certificate", uri, "-O", dest);
-		else if (auto curl = Filesystem::which("curl"))
-			cmd.append(*curl, "-L", uri, "-o", dest);
-		else if (auto powershell = Filesystem::which("powershell.exe"))
-			cmd.append(*powershell, "-command",
-				       "(new-object System.Net.WebClient).DownloadFile('" +
-				         uri + "', '" + dest.string() + "')");
-		else
-			CONFIGURE_THROW(
-				error::FileNotFound("Couldn't find any download program")
-				<< error::help("Please install curl or wget")
-			);
+		// Generators may give paths relative to the build directory.
+		auto dest = fs::absolute(relative_dest);
+		auto checksum = boost::to_lower_copy(sha256);
+		if (cache_dir.empty() || checksum.empty())
+			return download_verified(uri, dest, checksum);
 
-		Process::Options options;
-		Process::check_call(cmd.dump(), options);
+		auto cached = cache_dir / "sha256" / checksum.substr(0, 2) / checksum;
+		if (fs::is_regular_file(cached))
+			log::debug("Found", uri, "in the download cache:", cached);
+		else
+		{
+			log::debug("Downloading", uri, "to", cached);
+			download_verified(uri, cached, checksum);
+		}
+		fs::create_directories(dest.parent_path());
+		boost::system::error_code ec;
+		fs::remove(dest, ec);
+		fs::create_hard_link(cached, dest, ec);
+		if (ec)
+			fs::copy_file(cached, dest);
 	}
 
 }}
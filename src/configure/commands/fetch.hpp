@@ -5,6 +5,14 @@
 
 namespace configure { namespace commands {
 
-	void fetch(std::string const& uri, boost::filesystem::path const& dest);
+	// Download `uri` (http, https, ftp or file) to `dest`.
+	//
+	// When `sha256` is given the download is verified. If a `cache_dir` is
+	// also given, the file is looked up by checksum in the cache first and
+	// downloaded there otherwise, then linked to `dest`.
+	void fetch(std::string const& uri,
+	           boost::filesystem::path const& dest,
+	           std::string const& sha256 = "",
+	           boost::filesystem::path const& cache_dir = "");
 
 }}
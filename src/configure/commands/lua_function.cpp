@@ -2,19 +2,35 @@
 
 #include <configure/lua/State.hpp>
 #include <configure/bind.hpp>
+#include <configure/utils/path.hpp>
 
 namespace configure { namespace commands {
 
 	void lua_function(boost::filesystem::path const& script,
 	                  std::string const& function,
 	                  std::vector<std::string> const& args)
+	{ lua_function(script, function, {args}, lua_cache_directory()); }
+
+	void lua_function(boost::filesystem::path const& script,
+	                  std::string const& function,
+	                  std::vector<std::vector<std::string>> const& arg_sets,
+	                  boost::filesystem::path const& cache_dir)
 	{
 		lua::State lua;
 		bind(lua);
-		lua.load(script);
-		lua.getglobal(function.c_str());
-		for (auto& arg : args) lua.push(arg);
-		lua.call(args.size());
+		if (cache_dir.empty())
+			lua.load(script);
+		else
+			lua.load_cached(script, cache_dir);
+		for (auto& args: arg_sets)
+		{
+			lua.getglobal(function.c_str());
+			for (auto& arg : args) lua.push(arg);
+			lua.call(args.size(), 0);
+		}
 	}
 
+	boost::filesystem::path lua_cache_directory()
+	{ return utils::user_cache_directory("lua", "CONFIGURE_LUA_CACHE_DIR"); }
+
 }}
@@ -9,4 +9,14 @@ namespace configure { namespace commands {
 	void lua_function(boost::filesystem::path const& script,
 	                  std::string const& function,
 	                  std::vector<std::string> const& args);
+
+	// Call `function` once for each set of arguments, in the same Lua
+	// state. The compiled script is cached in `cache_dir` when not empty.
+	void lua_function(boost::filesystem::path const& script,
+	                  std::string const& function,
+	                  std::vector<std::vector<std::string>> const& arg_sets,
+	                  boost::filesystem::path const& cache_dir);
+
+	// Default directory for compiled scripts, empty when there is none.
+	boost::filesystem::path lua_cache_directory();
 }}
@@ -0,0 +1,20 @@
+#include "remove.hpp"
+
+#include <configure/log.hpp>
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace configure { namespace commands {
+
+	void remove(std::vector<fs::path> const& paths)
+	{
+		for (auto& path: paths)
+		{
+			log::debug("Removing", path);
+			fs::remove_all(path);
+		}
+	}
+
+}}
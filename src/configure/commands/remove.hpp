@@ -0,0 +1,12 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <vector>
+
+namespace configure { namespace commands {
+
+	// Remove files and directory trees, missing paths are ignored.
+	void remove(std::vector<boost::filesystem::path> const& paths);
+
+}}
@@ -1,27 +1,52 @@
 #include "touch.hpp"
 
-#include <configure/Filesystem.hpp>
-#include <configure/Process.hpp>
-#include <configure/Platform.hpp>
+#include <configure/error.hpp>
 
 #include <boost/filesystem.hpp>
 
+#include <ctime>
 #include <fstream>
 
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace fs = boost::filesystem;
+
 namespace configure { namespace commands {
 
 	void touch(boost::filesystem::path const& dest)
 	{
-		if (auto touch = Filesystem::which("touch"))
-			Process::check_call({touch->string(), dest.string()});
-		else if (Platform::current().os() == Platform::OS::windows)
-		{
-			if (!boost::filesystem::exists(dest))
-				std::ofstream(dest.string()).close();
-			else
-				Process::check_call(
-				  {"copy", "/b", dest.string() + "+,,", dest.string()});
-		}
+#ifdef _WIN32
+		if (!fs::exists(dest))
+			std::ofstream(dest.string()).close();
+		else
+			fs::last_write_time(dest, std::time(nullptr));
+#else
+		// No need to open the file when it exists.
+		if (::utimensat(AT_FDCWD, dest.c_str(), nullptr, 0) == 0)
+			return;
+		if (errno != ENOENT)
+			CONFIGURE_THROW(CONFIGURE_SYSTEM_ERROR("utimensat()") << error::path(dest));
+		int fd = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+		if (fd < 0)
+			CONFIGURE_THROW(CONFIGURE_SYSTEM_ERROR("open()") << error::path(dest));
+		::close(fd);
+#endif
+	}
+
+	void touch_stamp(boost::filesystem::path const& dest, std::string const& hash)
+	{
+		// Rewriting the file updates its modification time.
+		std::ofstream out(dest.string(), std::ios::binary | std::ios::trunc);
+		out << hash << '\n';
+		out.close();
+		if (!out)
+			CONFIGURE_THROW(
+				error::SystemError("Cannot write stamp file") << error::path(dest)
+			);
 	}
 
 }}
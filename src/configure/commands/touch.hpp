@@ -2,8 +2,14 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <string>
+
 namespace configure { namespace commands {
 
+	// Create `dest` or update its modification time.
 	void touch(boost::filesystem::path const& dest);
 
+	// Write `hash` in the stamp file `dest` and update its modification time.
+	void touch_stamp(boost::filesystem::path const& dest, std::string const& hash);
+
 }}
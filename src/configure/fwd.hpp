@@ -12,6 +12,7 @@ namespace configure {
 	class Environ;
 	class Filesystem;
 	class Generator;
+	class Manifest;
 	class Node;
 	class Platform;
 	class PropertyMap;
@@ -18,6 +18,7 @@
 
 #include <fstream>
 #include <unordered_set>
+#include <unordered_map>
 
 namespace configure { namespace generators {
 
@@ -163,7 +164,11 @@ namespace configure { namespace generators {
 					// We link as a dependency of then command outputs
 					auto obj = bg.node(boost::target(*out_edge_range.first, g));
 					_build.add_rule(Rule().add_source(target).add_target(obj));
-					cmd.append(std::move(obj));
+					// Written as make targets, they must match the rule names.
+					if (this->use_relative_path())
+						cmd.append(obj->relative_path(_build.directory()).string());
+					else
+						cmd.append(std::move(obj));
 				}
 				cmd.append("--");
 				for (auto& dir: include_directories)
@@ -210,6 +215,11 @@ namespace configure { namespace generators {
 					  value, command.working_directory()).string();
 				if (utils::starts_with(value, _project_dir))
 					return utils::relative_path(value, _build_dir).string();
+				// Commands do not depend on the build directory location,
+				// compiler launchers can share their cache between builds.
+				if (!command.has_working_directory() &&
+				    utils::starts_with(value, _build_dir))
+					return utils::relative_path(value, _build_dir).string();
 				return value.string();
 			}
 		};
@@ -272,43 +282,68 @@ namespace configure { namespace generators {
 		auto generated_commands_property_name =
 			std::string(this->name()) + "_GENERATED_COMMANDS";
 		std::unordered_set<Node const*> to_delete;
+		// Rules with several targets only run their commands once, the other
+		// targets depend on the first one, which is out of date when one of
+		// them is missing.
+		std::unordered_map<Command const*, Node*> command_targets;
+		bool has_secondary = false;
 		for (auto& node: _targets)
 		{
-			if (node->is_virtual())
-				out << node->name() << ':';
-			else
-				out << node_path(*node) << ':';
-
 			auto in_edge_range = boost::in_edges(node->index, g);
-			for (GraphTraits::in_edge_iterator i = in_edge_range.first;
-			     i != in_edge_range.second; ++i)
-			{
-				auto node = bg.node(boost::source(*i, g)).get();
-				if (node->is_file())
-					out << ' ' << node_path(*node);
-				else if (node->is_virtual())
-					out << ' ' << node->name();
-			}
-			out << std::endl;
-
 			std::vector<std::string> command_strings;
 			std::unordered_set<Command const*> seen_commands;
-			for (; in_edge_range.first != in_edge_range.second;
-			     ++in_edge_range.first)
+			Node* primary = nullptr;
+			bool secondary = true;
+			for (GraphTraits::in_edge_iterator i = in_edge_range.first;
+			     i != in_edge_range.second; ++i)
 			{
-				auto& link = bg.link(*in_edge_range.first);
+				auto& link = bg.link(*i);
 				Command const* cmd_ptr = &link.command();
 				if (seen_commands.insert(cmd_ptr).second == false)
 					continue;
-				for (auto const& shell_command: cmd_ptr->shell_commands())
-				{
+				auto shell_commands = this->shell_commands(*cmd_ptr);
+				if (shell_commands.empty())
+					continue; // Only adds dependencies
+				auto it = command_targets.emplace(cmd_ptr, node.get()).first;
+				if (it->second == node.get() || !it->second->is_file())
+					secondary = false;
+				else
+					primary = it->second;
+				for (auto const& shell_command: shell_commands)
 					command_strings.push_back(
 						this->dump_command(shell_command, link, *formatter)
 					);
-					out << '\t' << command_strings.back() << std::endl;
+			}
+			secondary = secondary && primary != nullptr && node->is_file();
+
+			if (node->is_virtual())
+				out << node->name() << ':';
+			else
+				out << node_path(*node) << ':';
+			if (secondary)
+				out << ' ' << node_path(*primary);
+			else
+			{
+				for (GraphTraits::in_edge_iterator i = in_edge_range.first;
+				     i != in_edge_range.second; ++i)
+				{
+					auto node = bg.node(boost::source(*i, g)).get();
+					if (node->is_file())
+						out << ' ' << node_path(*node);
+					else if (node->is_virtual())
+						out << ' ' << node->name();
 				}
 			}
 			out << std::endl;
+			if (secondary)
+			{
+				out << this->secondary_dependency(*node, *primary);
+				has_secondary = true;
+			}
+			else
+				for (auto const& command: command_strings)
+					out << '\t' << command << std::endl;
+			out << std::endl;
 			if (node->is_file())
 			{
 				bool had_commands_property = node->has_property(
@@ -333,6 +368,9 @@ namespace configure { namespace generators {
 			}
 		}
 
+		if (has_secondary)
+			out << "FORCE:\n\n";
+
 		for (auto node: to_delete)
 		{
 			try {
@@ -389,8 +427,15 @@ namespace configure { namespace generators {
 		return res + cmd_str;
 	}
 
+	std::string
+	Makefile::secondary_dependency(Node& target, Node& primary) const
+	{
+		return node_path(primary) + ": $(if $(wildcard " + node_path(target) +
+			"),,FORCE)\n";
+	}
+
 	bool Makefile::is_available(Build& build)
-	{ return build.fs().which("make") != boost::none; }
+	{ return build.fs().find_program("make") != boost::none; }
 
 	std::vector<std::string>
 	Makefile::build_command(std::string const& target) const
@@ -401,6 +446,9 @@ namespace configure { namespace generators {
 		};
 	}
 
+	std::vector<Generator::path_t> Makefile::build_files() const
+	{ return {_build.directory() / "Makefile"}; }
+
 	bool Makefile::use_relative_path() const { return true; }
 }}
 
@@ -28,6 +28,8 @@ namespace configure { namespace generators {
 		std::vector<std::string>
 		build_command(std::string const& target) const override;
 
+		std::vector<path_t> build_files() const override;
+
 	public:
 		static char const* name() { return "Makefile"; }
 		static bool is_available(Build& build);
@@ -36,6 +38,10 @@ namespace configure { namespace generators {
 		virtual std::string dump_command(ShellCommand const& cmd,
 		                                 DependencyLink const& link,
 		                                 ShellFormatter const& formatter) const;
+		// Dependency of `primary`, whose commands also generate `target`, on
+		// the FORCE rule when `target` is missing.
+		virtual std::string
+		secondary_dependency(Node& target, Node& primary) const;
 		virtual bool use_relative_path() const;
 		virtual void include_dependencies(std::ostream& out, bool relative) const;
 		virtual CommandParser command_parser() const;
@@ -19,7 +19,7 @@ namespace configure { namespace generators {
 
 	bool NMakefile::is_available(Build& build)
 	{
-		return build.fs().which("nmake") != boost::none;
+		return build.fs().find_program("nmake") != boost::none;
 	}
 
 	std::string NMakefile::dump_command(ShellCommand const& cmd,
@@ -61,6 +61,14 @@ namespace configure { namespace generators {
 		return res + quote<CommandParser::nmake>(cmd.string(_build, link, formatter));
 	}
 
+	std::string
+	NMakefile::secondary_dependency(Node& target, Node& primary) const
+	{
+		return "!IF !EXISTS(" + node_path(target) + ")\n" +
+			node_path(primary) + ": FORCE\n" +
+			"!ENDIF\n";
+	}
+
 	CommandParser NMakefile::command_parser() const
 	{ return CommandParser::nmake; }
 
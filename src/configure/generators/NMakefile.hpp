@@ -28,6 +28,8 @@ namespace configure { namespace generators {
 		std::string dump_command(ShellCommand const& cmd,
 		                         DependencyLink const& link,
 		                         ShellFormatter const& formatter) const override;
+		std::string
+		secondary_dependency(Node& target, Node& primary) const override;
 		bool use_relative_path() const override;
 		void include_dependencies(std::ostream& out, bool relative) const override;
 		CommandParser command_parser() const override;
@@ -45,7 +45,7 @@ namespace configure { namespace generators {
 				if (seen_commands.count(cmd_ptr) != 0)
 					continue;
 				seen_commands.insert(cmd_ptr);
-				for (auto const& shell_command: cmd_ptr->shell_commands())
+				for (auto const& shell_command: this->shell_commands(*cmd_ptr))
 				{
 					out <<  quote<CommandParser::unix_shell>(shell_command.string(_build, link)) << std::endl;
 				}
@@ -54,7 +54,7 @@ namespace configure { namespace generators {
 	}
 
 	bool Shell::is_available(Build& build)
-	{ return build.fs().which("sh") != boost::none; }
+	{ return build.fs().find_program("sh") != boost::none; }
 
 	std::vector<std::string>
 	Shell::build_command(std::string const& target) const
@@ -66,4 +66,7 @@ namespace configure { namespace generators {
 		};
 	}
 
+	std::vector<Generator::path_t> Shell::build_files() const
+	{ return {_build.directory() / "build.sh"}; }
+
 }}
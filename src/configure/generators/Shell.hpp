@@ -20,6 +20,8 @@ namespace configure { namespace generators {
 		std::vector<std::string>
 		build_command(std::string const& target) const override;
 
+		std::vector<path_t> build_files() const override;
+
 	public:
 		static char const* name() { return "Shell"; }
 		static bool is_available(Build& build);
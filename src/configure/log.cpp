@@ -1,5 +1,7 @@
 #include "log.hpp"
 
+#include <mutex>
+
 namespace configure { namespace log {
 
 	static Level get_default_log_level()
@@ -17,6 +19,13 @@ namespace configure { namespace log {
 		return value;
 	}
 
+	void _write(std::string const& line)
+	{
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> guard(mutex);
+		std::cerr << line << std::flush;
+	}
+
 	bool is_enabled(Level lvl)
 	{
 		return static_cast<int>(lvl) >= static_cast<int>(level());
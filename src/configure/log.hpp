@@ -1,23 +1,32 @@
 #pragma once
 
 #include <iostream>
+#include <sstream>
 
 namespace configure { namespace log {
 
 	template<bool>
-	void _print() { std::cerr << std::endl; }
+	void _print(std::ostream& out) { out << '\n'; }
 
 	template<bool is_first, typename T, typename... Args>
-	void _print(T&& first, Args&&... tail)
+	void _print(std::ostream& out, T&& first, Args&&... tail)
 	{
-		if (!is_first) std::cerr << ' ';
-		std::cerr << first;
-		_print<false>(std::forward<Args>(tail)...);
+		if (!is_first) out << ' ';
+		out << first;
+		_print<false>(out, std::forward<Args>(tail)...);
 	}
 
+	// Write a whole line at once, lines from different threads are never
+	// mixed.
+	void _write(std::string const& line);
 
 	template<typename... Args>
-	void print(Args&&... args) { _print<true>(std::forward<Args>(args)...); }
+	void print(Args&&... args)
+	{
+		std::ostringstream out;
+		_print<true>(out, std::forward<Args>(args)...);
+		_write(out.str());
+	}
 
 	enum class Level : int
 	{ debug = 0, verbose, status, warning, error };
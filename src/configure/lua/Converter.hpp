@@ -1,6 +1,7 @@
 #pragma once
 
 #include "fwd.hpp"
+#include <configure/fwd.hpp>
 #include <configure/log.hpp>
 
 #include <string>
@@ -11,8 +12,9 @@
 
 namespace configure { namespace lua {
 
+	// Store values of type T in full userdata.
 	template<typename T>
-	struct Converter
+	struct UserdataConverter
 	{
 		typedef T& extract_type;
 
@@ -84,10 +86,22 @@ namespace configure { namespace lua {
 		}
 	};
 
+	template<typename T>
+	struct Converter : UserdataConverter<T> {};
+
 	template<typename T> struct Converter<T*> : Converter<T> {};
 	template<typename T> struct Converter<T&> : Converter<T> {};
 	template<typename T> struct Converter<T const> : Converter<T> {};
 
+	// A node is pushed only once per lua state: the userdata is kept in a
+	// weak registry table so that the same node is always the same lua value
+	// (usable as a table key and comparable with rawequal). Declared here so
+	// that every user of the converter sees it.
+	template<> struct Converter<NodePtr> : UserdataConverter<NodePtr>
+	{
+		static NodePtr& push(lua_State* state, NodePtr const& node);
+	};
+
 	template<>
 	struct Converter<std::string>
 	{
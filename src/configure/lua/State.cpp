@@ -1,12 +1,18 @@
 #include "State.hpp"
 #include "traceback.hpp"
+
+#include <configure/utils/sha256.hpp>
+
 #define BOOST_POOL_INSTRUMENT
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/pool/pool.hpp>
 #include <boost/assert.hpp>
 #include <boost/scope_exit.hpp>
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <map>
 
 namespace configure { namespace lua {
@@ -561,6 +567,21 @@ namespace configure { namespace lua {
 			return 1;
 		}
 
+		int string_sha256(lua_State* state)
+		{
+			size_t size = 0;
+			char const* str = lua_tolstring(state, 1, &size);
+			if (str == nullptr)
+			{
+				lua_pushstring(state, "string:sha256() expect a string");
+				lua_error(state);
+			}
+			utils::Sha256 hash;
+			hash.update(str, size);
+			lua_pushstring(state, hash.hexdigest().c_str());
+			return 1;
+		}
+
 	}
 
 
@@ -578,6 +599,7 @@ namespace configure { namespace lua {
 		SET_METHOD("rstrip", &string_strip<StripAlgo::right>);
 		SET_METHOD("lstrip", &string_strip<StripAlgo::left>);
 		SET_METHOD("split", &string_split);
+		SET_METHOD("sha256", &string_sha256);
 
 		lua_getglobal(_state, "table");
 		SET_METHOD("append", &table_append);
@@ -610,6 +632,63 @@ namespace configure { namespace lua {
 		this->call(0, ret);
 	}
 
+	namespace {
+
+		int string_writer(lua_State*, void const* data, size_t size, void* ud)
+		{
+			static_cast<std::string*>(ud)->append(
+				static_cast<char const*>(data), size
+			);
+			return 0;
+		}
+
+	}
+
+	void State::load_cached(boost::filesystem::path const& p,
+	                        boost::filesystem::path const& cache_dir,
+	                        int ret)
+	{
+		namespace fs = boost::filesystem;
+		// Bytecode is specific to the Lua version and the architecture.  The
+		// content is hashed because mtime and size miss same-second edits.
+		auto source = fs::absolute(p);
+		auto key = source.string() + '\0' +
+			utils::sha256_file(source) + '\0' +
+			LUA_VERSION_RELEASE + '\0' + std::to_string(sizeof(void*));
+		auto cached = cache_dir / (utils::sha256(key) + ".luac");
+		auto chunk_name = "@" + p.string();
+		{
+			std::ifstream in(cached.string(), std::ios::binary);
+			std::string bytecode{
+				std::istreambuf_iterator<char>(in),
+				std::istreambuf_iterator<char>()
+			};
+			if (!bytecode.empty() &&
+			    luaL_loadbufferx(_state, bytecode.data(), bytecode.size(),
+			                     chunk_name.c_str(), "b") == LUA_OK)
+				return this->call(0, ret);
+			if (!bytecode.empty())
+				lua_pop(_state, 1); // Invalid cache entry
+		}
+		check_status(_state, luaL_loadfile(_state, p.string().c_str()));
+		std::string bytecode;
+		if (lua_dump(_state, &string_writer, &bytecode, 0) == 0)
+		{
+			// Concurrent invocations write the same content.
+			boost::system::error_code ec;
+			fs::create_directories(cache_dir, ec);
+			auto tmp = cached.string() + fs::unique_path(".%%%%%%%%").string();
+			std::ofstream out(tmp, std::ios::binary);
+			out.write(bytecode.data(), bytecode.size());
+			out.close();
+			if (out)
+				fs::rename(tmp, cached, ec);
+			if (!out || ec)
+				fs::remove(tmp, ec);
+		}
+		this->call(0, ret);
+	}
+
 	void State::load(std::string const& buffer, int ret)
 	{ this->load(buffer.c_str(), ret); }
 
@@ -42,6 +42,12 @@ namespace configure { namespace lua {
 		// Load and run a lua file.
 		void load(boost::filesystem::path const& p, int ret = 0);
 
+		// Same as load(), but the compiled chunk is saved in `cache_dir` and
+		// reused as long as the file does not change.
+		void load_cached(boost::filesystem::path const& p,
+		                 boost::filesystem::path const& cache_dir,
+		                 int ret = 0);
+
 		// Load and run lua code.
 		void load(std::string const& buffer, int ret = 0);
 		void load(char const* buffer, int ret = 0);
@@ -0,0 +1,229 @@
+#include "glob.hpp"
+
+namespace configure { namespace utils {
+
+	namespace {
+
+		// Match `c` against the set starting at `pattern[start]` (a '[').
+		// Returns false when the set is not closed, in which case the '['
+		// is a regular character.
+		bool match_set(std::string const& pattern,
+		               size_t start,
+		               char c,
+		               size_t& next,
+		               bool& matched)
+		{
+			size_t i = start + 1;
+			bool negate = false;
+			if (i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^'))
+			{
+				negate = true;
+				i += 1;
+			}
+			size_t const first = i;
+			bool found = false;
+			while (i < pattern.size() && (pattern[i] != ']' || i == first))
+			{
+				char lo = pattern[i];
+				if (i + 2 < pattern.size() && pattern[i + 1] == '-' &&
+				    pattern[i + 2] != ']')
+				{
+					if (lo <= c && c <= pattern[i + 2])
+						found = true;
+					i += 3;
+				}
+				else
+				{
+					if (lo == c)
+						found = true;
+					i += 1;
+				}
+			}
+			if (i >= pattern.size())
+				return false;
+			next = i + 1;
+			matched = (found != negate);
+			return true;
+		}
+
+		bool match_components(std::vector<std::string> const& pattern,
+		                      size_t pi,
+		                      std::vector<std::string> const& components,
+		                      size_t ci)
+		{
+			for (; pi < pattern.size(); ++pi, ++ci)
+			{
+				if (pattern[pi] == "**")
+				{
+					for (size_t i = ci; i <= components.size(); ++i)
+						if (match_components(pattern, pi + 1, components, i))
+							return true;
+					return false;
+				}
+				if (ci >= components.size() ||
+				    !match_name(pattern[pi], components[ci]))
+					return false;
+			}
+			return ci == components.size();
+		}
+
+	}
+
+	bool match_name(std::string const& pattern, std::string const& name)
+	{
+		if (!name.empty() && name[0] == '.' &&
+		    (pattern.empty() || pattern[0] != '.'))
+			return false;
+
+		size_t const npos = std::string::npos;
+		size_t p = 0, n = 0;
+		size_t star_p = npos, star_n = 0;
+		while (n < name.size())
+		{
+			bool advanced = false;
+			if (p < pattern.size())
+			{
+				char c = pattern[p];
+				if (c == '*')
+				{
+					star_p = ++p;
+					star_n = n;
+					continue;
+				}
+				size_t next = p + 1;
+				bool matched = false;
+				if (c == '?')
+					matched = true;
+				else if (c != '[' || !match_set(pattern, p, name[n], next, matched))
+				{
+					if (c == '\\' && p + 1 < pattern.size())
+					{
+						c = pattern[p + 1];
+						next = p + 2;
+					}
+					matched = (c == name[n]);
+				}
+				if (matched)
+				{
+					p = next;
+					n += 1;
+					advanced = true;
+				}
+			}
+			if (!advanced)
+			{
+				// Let the last star eat one more character.
+				if (star_p == npos)
+					return false;
+				p = star_p;
+				n = ++star_n;
+			}
+		}
+		while (p < pattern.size() && pattern[p] == '*')
+			p += 1;
+		return p == pattern.size();
+	}
+
+	std::vector<std::string> expand_braces(std::string const& pattern)
+	{
+		size_t open = pattern.find('{');
+		size_t close = std::string::npos;
+		std::vector<std::string> alternatives;
+		if (open != std::string::npos)
+		{
+			int depth = 0;
+			size_t last = open + 1;
+			for (size_t i = open; i < pattern.size(); ++i)
+			{
+				if (pattern[i] == '{')
+					depth += 1;
+				else if (pattern[i] == '}' && --depth == 0)
+				{
+					close = i;
+					break;
+				}
+				else if (pattern[i] == ',' && depth == 1)
+				{
+					alternatives.push_back(pattern.substr(last, i - last));
+					last = i + 1;
+				}
+			}
+			if (close != std::string::npos)
+				alternatives.push_back(pattern.substr(last, close - last));
+		}
+		if (close == std::string::npos)
+			return {pattern};
+
+		std::string prefix = pattern.substr(0, open);
+		auto suffixes = expand_braces(pattern.substr(close + 1));
+		std::vector<std::string> expanded;
+		if (alternatives.size() == 1)
+		{
+			// Not a set, the braces are regular characters.
+			for (auto& alt: expand_braces(alternatives[0]))
+				expanded.push_back("{" + alt + "}");
+		}
+		else
+		{
+			for (auto& alt: alternatives)
+				for (auto& e: expand_braces(alt))
+					expanded.push_back(e);
+		}
+		std::vector<std::string> res;
+		for (auto& e: expanded)
+			for (auto& suffix: suffixes)
+				res.push_back(prefix + e + suffix);
+		return res;
+	}
+
+	GlobPattern::GlobPattern()
+	{}
+
+	GlobPattern::GlobPattern(std::string const& pattern)
+	{ this->add(pattern); }
+
+	GlobPattern::GlobPattern(std::vector<std::string> const& patterns)
+	{
+		for (auto& pattern: patterns)
+			this->add(pattern);
+	}
+
+	void GlobPattern::add(std::string const& pattern)
+	{
+		for (auto& alternative: expand_braces(pattern))
+		{
+			std::vector<std::string> components;
+			bool anchored = false;
+			size_t start = 0;
+			while (start <= alternative.size())
+			{
+				size_t end = alternative.find('/', start);
+				if (end == std::string::npos)
+					end = alternative.size();
+				auto component = alternative.substr(start, end - start);
+				start = end + 1;
+				if (component.empty() || component == ".")
+					continue;
+				if (component == "**")
+				{
+					anchored = true;
+					if (!components.empty() && components.back() == "**")
+						continue;
+				}
+				components.push_back(std::move(component));
+			}
+			if (!anchored)
+				components.insert(components.begin(), "**");
+			_alternatives.push_back(std::move(components));
+		}
+	}
+
+	bool GlobPattern::match(std::vector<std::string> const& components) const
+	{
+		for (auto& alternative: _alternatives)
+			if (match_components(alternative, 0, components, 0))
+				return true;
+		return false;
+	}
+
+}}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace configure { namespace utils {
+
+	// Match a file name against a shell wildcard pattern (`*`, `?` and
+	// `[...]` character sets). As with the shell, wildcards do not match a
+	// leading dot.
+	bool match_name(std::string const& pattern, std::string const& name);
+
+	// Expand brace sets: "*.{c,cpp}" gives "*.c" and "*.cpp".
+	std::vector<std::string> expand_braces(std::string const& pattern);
+
+	// Compiled glob patterns matched against relative paths.
+	//
+	// Patterns are split on '/' and their brace sets are expanded once. A
+	// `**` component matches any number of directories. A pattern without
+	// `**` matches at any depth, so "*.cpp" matches "a.cpp" and "src/a.cpp".
+	class GlobPattern
+	{
+	private:
+		std::vector<std::vector<std::string>> _alternatives;
+
+	public:
+		GlobPattern();
+		explicit GlobPattern(std::string const& pattern);
+		explicit GlobPattern(std::vector<std::string> const& patterns);
+
+	public:
+		void add(std::string const& pattern);
+		bool empty() const { return _alternatives.empty(); }
+
+		// Whether one of the patterns matches the relative path given as a
+		// list of components.
+		bool match(std::vector<std::string> const& components) const;
+	};
+
+}}
@@ -2,6 +2,8 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <cstdlib>
+
 namespace configure { namespace utils {
 
 	boost::filesystem::path
@@ -59,5 +61,23 @@ namespace configure { namespace utils {
 		return true;
 	}
 
+	boost::filesystem::path
+	user_cache_directory(std::string const& name, char const* env_var)
+	{
+		if (char const* dir = std::getenv(env_var))
+			return dir;
+		if (char const* dir = std::getenv("XDG_CACHE_HOME"))
+			if (*dir != '\0')
+				return boost::filesystem::path(dir) / "configure" / name;
+#ifdef _WIN32
+		if (char const* dir = std::getenv("LOCALAPPDATA"))
+			return boost::filesystem::path(dir) / "configure" / name;
+#else
+		if (char const* home = std::getenv("HOME"))
+			return boost::filesystem::path(home) / ".cache" / "configure" / name;
+#endif
+		return boost::filesystem::path();
+	}
+
 }}
 
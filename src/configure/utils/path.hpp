@@ -3,6 +3,8 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/serialization/split_free.hpp>
 
+#include <string>
+
 namespace configure { namespace utils {
 
 	boost::filesystem::path
@@ -12,6 +14,13 @@ namespace configure { namespace utils {
 	bool starts_with(boost::filesystem::path const& path,
 	                 boost::filesystem::path const& prefix);
 
+	// Per user cache directory for `name`: the environment variable
+	// `env_var` when set (an empty value disables the cache), otherwise
+	// `$XDG_CACHE_HOME/configure/<name>` or `~/.cache/configure/<name>`.
+	// Returns an empty path when there is none.
+	boost::filesystem::path
+	user_cache_directory(std::string const& name, char const* env_var);
+
 }}
 
 namespace boost { namespace serialization {
@@ -0,0 +1,127 @@
+#include "sha256.hpp"
+
+#include <configure/error.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace configure { namespace utils {
+
+	namespace {
+
+		uint32_t const k[64] = {
+			0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+			0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+			0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+			0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+			0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+			0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+			0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+			0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+		};
+
+		inline uint32_t rotr(uint32_t x, unsigned n)
+		{ return (x >> n) | (x << (32 - n)); }
+
+	}
+
+	Sha256::Sha256()
+		: _state{
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+			0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+		}
+		, _size(0)
+	{}
+
+	void Sha256::update(void const* data, size_t size)
+	{
+		auto bytes = static_cast<unsigned char const*>(data);
+		size_t used = _size % 64;
+		_size += size;
+		if (used != 0)
+		{
+			size_t n = std::min(size, 64 - used);
+			std::memcpy(_block + used, bytes, n);
+			bytes += n;
+			size -= n;
+			if (used + n < 64)
+				return;
+			_process(_block);
+		}
+		for (; size >= 64; bytes += 64, size -= 64)
+			_process(bytes);
+		std::memcpy(_block, bytes, size);
+	}
+
+	std::string Sha256::hexdigest()
+	{
+		uint64_t bits = _size * 8;
+		unsigned char padding[72] = {0x80};
+		size_t used = _size % 64;
+		size_t padding_size = (used < 56 ? 56 : 120) - used;
+		for (int i = 0; i < 8; ++i)
+			padding[padding_size + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+		update(padding, padding_size + 8);
+
+		static char const hex[] = "0123456789abcdef";
+		std::string res;
+		for (uint32_t word: _state)
+			for (int shift = 28; shift >= 0; shift -= 4)
+				res += hex[(word >> shift) & 0xf];
+		return res;
+	}
+
+	void Sha256::_process(unsigned char const* block)
+	{
+		uint32_t w[64];
+		for (int i = 0; i < 16; ++i)
+			w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) |
+			       (uint32_t(block[4 * i + 2]) << 8) | uint32_t(block[4 * i + 3]);
+		for (int i = 16; i < 64; ++i)
+		{
+			uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+		uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3],
+		         e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+		for (int i = 0; i < 64; ++i)
+		{
+			uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+			              ((e & f) ^ (~e & g)) + k[i] + w[i];
+			uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+			              ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		_state[0] += a; _state[1] += b; _state[2] += c; _state[3] += d;
+		_state[4] += e; _state[5] += f; _state[6] += g; _state[7] += h;
+	}
+
+	std::string sha256(std::string const& data)
+	{
+		Sha256 hash;
+		hash.update(data.data(), data.size());
+		return hash.hexdigest();
+	}
+
+	std::string sha256_file(boost::filesystem::path const& path)
+	{
+		std::ifstream in(path.string(), std::ios::binary);
+		if (!in)
+			CONFIGURE_THROW(
+				error::FileNotFound("Cannot open file") << error::path(path)
+			);
+		Sha256 hash;
+		std::vector<char> buffer(1 << 16);
+		while (in)
+		{
+			in.read(buffer.data(), buffer.size());
+			hash.update(buffer.data(), in.gcount());
+		}
+		return hash.hexdigest();
+	}
+
+}}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace configure { namespace utils {
+
+	// Incremental SHA-256.
+	class Sha256
+	{
+	private:
+		uint32_t _state[8];
+		uint64_t _size;
+		unsigned char _block[64];
+
+	public:
+		Sha256();
+
+	public:
+		void update(void const* data, size_t size);
+
+		// Lower case hexadecimal digest. The instance must not be updated
+		// afterwards.
+		std::string hexdigest();
+
+	private:
+		void _process(unsigned char const* block);
+	};
+
+	std::string sha256(std::string const& data);
+	std::string sha256_file(boost::filesystem::path const& path);
+
+}}
@@ -51,6 +51,12 @@ end
 -- @param args.url The download link
 -- @param args.filename The filename if it cannot be infered from the url.
 -- @param args.method Method used to retreive the sources (defaults to 'fetch')
+-- @param args.sha256 Expected checksum of the file. When set, the file is
+-- verified and shared through the download cache (see the
+-- DOWNLOAD_CACHE_DIR option or the CONFIGURE_DOWNLOAD_CACHE_DIR environment
+-- variable).
+-- @param args.strip_components Number of leading path components removed
+-- when extracting (defaults to 1 for tarballs and 0 for zip files)
 function Project:download(args)
 	local args = table.update(
 		{method = 'fetch'},
@@ -74,18 +80,47 @@ function Project:_download_tarball(args)
 	end
 	local download_dir = self:step_directory('download')
 	local tarball = download_dir / filename
+	local fetch = {self._build:configure_program(), '-E', 'fetch'}
+	if args.sha256 ~= nil then
+		table.extend(fetch, {'--sha256', args.sha256})
+		local cache_dir = self:download_cache_directory()
+		if cache_dir ~= nil then
+			table.extend(fetch, {'--cache-dir', cache_dir})
+		end
+	end
+	table.extend(fetch, {args.url, tarball})
+	local extract = {self._build:configure_program(), '-E', 'extract'}
+	if args.strip_components ~= nil then
+		table.extend(extract, {'--strip-components', tostring(args.strip_components)})
+	end
+	table.extend(extract, {tarball, self:step_directory('extract')})
 	return self:add_step{
 		name = 'download',
 		targets = {
 			[0] = {
-				{self._build:configure_program(), '-E', 'fetch', args.url, tarball},
-				{self._build:configure_program(), '-E', 'extract', tarball, self:step_directory('extract')}
+				fetch,
+				extract,
 			}
 		},
 		sources = args.sources,
 	}
 end
 
+--- Shared directory where downloads are stored by checksum, or nil.
+function Project:download_cache_directory()
+	local default = os.getenv('CONFIGURE_DOWNLOAD_CACHE_DIR')
+	if default ~= nil and #default > 0 then
+		default = Path:new(default)
+	else
+		default = nil
+	end
+	return self._build:path_option(
+		'DOWNLOAD_CACHE_DIR',
+		"Download cache shared between build directories",
+		default
+	)
+end
+
 function Project:configure(args)
 	return self:add_step{
 		name = 'configure',
@@ -157,6 +192,7 @@ function Project:add_step(args)
 	for _, p in ipairs(previous) do
 		stamped_rule:add_source(p)
 	end
+	local description = {}
 	for target, commands in pairs(args.targets or {}) do
 		local rule = stamped_rule
 		if target ~= 0 then
@@ -175,19 +211,44 @@ function Project:add_step(args)
 				cmd:env(args.env)
 			end
 			rule:add_shell_command(cmd)
+			table.append(description, tostring(target) .. ': ' .. tostring(cmd))
 		end
 
 		if rule ~= stamped_rule then self._build:add_rule(rule) end
 	end
 
+	-- The stamp records what produced it, the step runs again when its
+	-- commands change.
+	for key, value in pairs(args.env or {}) do
+		table.append(description, 'env: ' .. tostring(key) .. '=' .. tostring(value))
+	end
+	table.sort(description)
+	table.append(description, tostring(args.working_directory))
+	local hash = table.concat(description, '\n'):sha256()
+	self:_check_stamp(stamp, hash)
 	stamped_rule:add_shell_command(
-		ShellCommand:new(self._build:configure_program(), '-E', 'touch', stamp)
+		ShellCommand:new(
+			self._build:configure_program(), '-E', 'touch', '--hash', hash, stamp
+		)
 	)
 	table.append(self.steps, stamp)
 	self._build:add_rule(stamped_rule)
 	return self
 end
 
+-- Remove a stamp written for other commands.
+function Project:_check_stamp(stamp, hash)
+	local path = tostring(stamp:path())
+	local f = io.open(path, 'r')
+	if f == nil then return end
+	local content = f:read('l')
+	f:close()
+	if content ~= hash then
+		self._build:debug("Commands of", stamp, "changed, removing the stamp")
+		os.remove(path)
+	end
+end
+
 function Project:last_step()
 	if #self.steps > 0 then
 		return self.steps[#self.steps]
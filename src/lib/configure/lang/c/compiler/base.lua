@@ -99,6 +99,41 @@
 -- : Enable big object file generation (Increase the number of sections per
 -- object) (defaults to false).
 --
+-- `precompiled_header`
+-- : A header compiled once per target and included before every source
+-- file (defaults to `nil`).
+--
+-- `lto`
+-- : Link time optimization mode, "thin", "full" or false (defaults to the
+-- `LTO` option). Compilers without thin LTO do a full one.
+--
+-- `pgo_training`
+-- : Training command of a profile guided optimization (executables only,
+-- defaults to `nil`). It is a list of arguments given to the instrumented
+-- executable, or a function called with the instrumented executable node
+-- returning the whole command. The optimized executable is built by `make`
+-- or `make pgo` after the training (disabled by the `PGO` option).
+--
+-- `thin_archive`
+-- : Static libraries only reference their objects (defaults to the
+-- `THIN_ARCHIVES` option). Installed libraries are always complete.
+--
+-- `split_dwarf`
+-- : Put the debug informations in separate `.dwo` files when supported
+-- (defaults to the `SPLIT_DWARF` option).
+--
+-- `unity_build`
+-- : Compile sources in batches, each batch being a generated source file
+-- including them (defaults to the `UNITY_BUILD` option).
+--
+-- `unity_batch_size`
+-- : Average number of sources per batch (defaults to the
+-- `UNITY_BUILD_BATCH_SIZE` option, or 8).
+--
+-- `unity_exclude`
+-- : Sources always compiled alone in a unity build (defaults to an empty
+-- list).
+--
 -- @classmod configure.lang.c.compiler.base
 
 local undefined = {}
@@ -108,6 +143,9 @@ local M = {
 	--- Library type used by the compiler.
 	Library = require('configure.lang.c.Library'),
 
+	--- Compiler launchers detected when COMPILER_LAUNCHER is not set.
+	launcher_names = {'ccache', 'sccache'},
+
 	optional_args = {
 		env_name = nil,
 		coverage = false,
@@ -136,6 +174,14 @@ local M = {
 		allow_unresolved_symbols = false,
 		export_dynamic = false,
 		big_object = false,
+		precompiled_header = nil,
+		lto = nil,
+		pgo_training = nil,
+		thin_archive = nil,
+		split_dwarf = nil,
+		unity_build = nil,
+		unity_batch_size = nil,
+		unity_exclude = {},
 	},
 }
 
@@ -199,8 +245,7 @@ function M:link_executable(args)
 	local standard_library = args.standard_library or self.standard_library
 	local directory = Path:new(args.directory or self.executable_directory)
 	local libraries = self:_libraries(args)
-	local target = self:_link_executable{
-		objects = self:_build_objects(args),
+	local link_args = {
 		target = self.build:target_node(
 			(directory / args.name) + self:_executable_extension(args.extension)
 		),
@@ -212,14 +257,28 @@ function M:link_executable(args)
 		coverage = self:_coverage(args),
 		threading = self:_threading(args),
 		debug = self:_debug(args),
+		split_dwarf = self:_split_dwarf(args),
 		debug_runtime = self:_debug_runtime(args),
 		exception = self:_exception(args),
 		warnings = self:_warnings(args),
 		optimization = self:_optimization(args),
+		lto = self:_lto(args),
 		allow_unresolved_symbols = self:_allow_unresolved_symbols(args),
 		export_dynamic = self:_export_dynamic(args),
 		runtime = self:_runtime(args),
 	}
+	local objects_args = args
+	if self:_pgo(args) then
+		link_args.pgo = self:_add_profile_guided_optimization(args, link_args)
+		objects_args = table.update({pgo = link_args.pgo}, args)
+	end
+	link_args.objects = self:_build_objects(objects_args)
+	local target = self:_link_executable(link_args)
+	if link_args.pgo ~= nil then
+		self.build:add_rule(
+			Rule:new():add_source(target):add_target(self.build:virtual_node('pgo'))
+		)
+	end
 
 	if self:_install_executable(args) then
 		target:set_property("install", true)
@@ -284,16 +343,19 @@ function M:link_library(args)
 		standard = standard,
 		standard_library = standard_library,
 		import_library_directory = args.import_library_directory or self.static_library_directory,
+		thin_archive = self:_thin_archive(args),
 		libraries = libraries,
 		export_libraries = self:_export_libraries(args),
 		library_directories = self:_library_directories(args),
 		coverage = self:_coverage(args),
 		threading = self:_threading(args),
 		debug = self:_debug(args),
+		split_dwarf = self:_split_dwarf(args),
 		debug_runtime = self:_debug_runtime(args),
 		exception = self:_exception(args),
 		warnings = self:_warnings(args),
 		optimization = self:_optimization(args),
+		lto = self:_lto(args),
 		allow_unresolved_symbols = self:_allow_unresolved_symbols(args),
 		export_dynamic = self:_export_dynamic(args),
 		runtime = runtime,
@@ -417,7 +479,123 @@ end
 
 
 --- Try to compile some source code
+--
+-- The result is shared with other build directories using the same compiler
+-- (see `Build:shared_probe`).
 function M:try_build_object(name, content, args)
+	return self:_try_build_object(name, content, args)
+end
+
+function M:has_include(name, args)
+	return self:try_build_object(
+		self:_has_include_check_name(name),
+		"#include <" .. name .. ">",
+		args or {}
+	)
+end
+
+local function slice(list, first, last)
+	local res = {}
+	for i = first, last do table.append(res, list[i]) end
+	return res
+end
+
+--- Check for many headers at once.
+--
+-- Results are cached individually, as if `has_include` was called for each
+-- header, but the missing ones are probed together, in one or a few compiler
+-- invocations.
+--
+-- @tparam table names List of header names
+-- @param[opt] args Arguments given to the compiler
+-- @treturn table A table mapping header names to a boolean
+function M:has_includes(names, args)
+	local res = {}
+	local batch = nil
+	for idx, name in ipairs(names) do
+		res[name] = self:_try_build_object(
+			self:_has_include_check_name(name),
+			"#include <" .. name .. ">",
+			args or {},
+			function()
+				-- First result not found in the caches, the remaining headers
+				-- are very likely not cached either.
+				if batch == nil or batch[name] == nil then
+					batch = self:_probe_has_includes(
+						slice(names, idx, #names),
+						args or {}
+					)
+				end
+				return batch[name]
+			end
+		)
+	end
+	return res
+end
+
+-------------------------------------------------------------------------------
+--- Private methods
+--
+-- Utilities used internally.
+-- @section
+
+--- Identify the compiler: its path, a hash of its content and its version.
+function M:identity()
+	return self.binary:set_cached_property(
+		'compiler-identity',
+		function ()
+			local path = tostring(self.binary:path())
+			local f = assert(io.open(path, 'rb'))
+			local content = f:read('a')
+			f:close()
+			return table.concat({path, content:sha256(), self:_version_output()}, '\n')
+		end
+	)
+end
+
+--- Output of the compiler version command, part of its identity.
+function M:_version_output()
+	return Process:check_output(
+		{self.binary, '--version'},
+		{stderr = Process.Stream.DEVNULL, ignore_errors = true}
+	)
+end
+
+--- Compute a probe result once for all build directories using this
+-- compiler.
+--
+-- @string name The probe name
+-- @string input What the result depends on besides the compiler identity
+-- @func fn Compute the result
+function M:_shared_probe(name, input, fn)
+	return self.build:shared_probe(
+		table.concat({self:identity(), name, input}, '\n'),
+		fn
+	)
+end
+
+--- Stringify commands, independently of the temporary directory used.
+function M:_probe_commands_key(commands, dir)
+	local res = {}
+	for _, cmd in ipairs(commands) do
+		for _, arg in ipairs(cmd) do
+			if type(arg) == 'table' or type(arg) == 'userdata' then
+				arg = tools.path(arg)
+			end
+			table.append(res, tostring(arg))
+		end
+		table.append(res, '')
+	end
+	return (table.concat(res, '\n'):gsub(
+		tostring(dir):gsub('%p', '%%%0'), '<probe>'
+	))
+end
+
+--- Cached compilation check.
+--
+-- @param compute Replaces the compilation of `content` when the result is
+-- not cached.
+function M:_try_build_object(name, content, args, compute)
 	return self.binary:set_cached_property(
 		"check-" .. name,
 		function()
@@ -427,33 +605,69 @@ function M:try_build_object(name, content, args)
 			args.source = dir:path() / (name .. '.c')
 			args.target = args.source + '.o'
 
-			local f = assert(io.open(tostring(args.source) , 'w'))
-			f:write(content)
-			f:close()
-
 			local commands = self:_build_object(args).commands
-			for _, cmd in ipairs(commands) do
-				if Process:call(cmd) ~= 0 then return false end
-			end
-			return true
+			return self:_shared_probe(
+				'check',
+				content .. '\n' .. self:_probe_commands_key(commands, dir:path()),
+				compute or function()
+					return self:_compile_probe(args.source, content, commands)
+				end
+			)
 		end
 	)
 end
 
-function M:has_include(name, args)
-	local check_name = name:gsub('/', '-'):gsub('%.', '-'):gsub('\\', '-')
-	return self:try_build_object(
-		"has-include-" .. check_name,
-		"#include <" .. name .. ">",
-		args or {}
-	)
+function M:_has_include_check_name(name)
+	return "has-include-" .. name:gsub('/', '-'):gsub('%.', '-'):gsub('\\', '-')
 end
 
--------------------------------------------------------------------------------
---- Private methods
+--- Write `content` in `source` and run the compilation `commands`.
 --
--- Utilities used internally.
--- @section
+-- @treturn bool Whether all commands succeeded
+function M:_compile_probe(source, content, commands)
+	local f = assert(io.open(tostring(source) , 'w'))
+	f:write(content)
+	f:close()
+	for _, cmd in ipairs(commands) do
+		if Process:call(cmd) ~= 0 then return false end
+	end
+	return true
+end
+
+--- Probe headers without caching the results.
+--
+-- All headers are included in one source file, halves are checked again
+-- until the missing ones are found.
+--
+-- @treturn table A table mapping header names to a boolean
+function M:_probe_has_includes(names, args)
+	args = self:_normalize_build_object_args(args)
+	local dir = TemporaryDirectory:new()
+	local res = {}
+	local function probe(list)
+		if #list == 0 then return end
+		local content = {}
+		for _, name in ipairs(list) do
+			table.append(content, "#include <" .. name .. ">")
+		end
+		args.source = dir:path() / 'has-includes.c'
+		args.target = args.source + '.o'
+		local ok = self:_compile_probe(
+			args.source,
+			table.concat(content, '\n'),
+			self:_build_object(args).commands
+		)
+		if ok or #list == 1 then
+			for _, name in ipairs(list) do res[name] = ok end
+		else
+			local half = #list // 2
+			probe(slice(list, 1, half))
+			probe(slice(list, half + 1, #list))
+		end
+	end
+	probe(names)
+	return res
+end
 
 function M:_normalize_build_object_args(args)
 	local res = table.update({}, args)
@@ -468,10 +682,18 @@ function M:_normalize_build_object_args(args)
 	res.coverage = self:_coverage(args)
 	res.threading = self:_threading(args)
 	res.debug = self:_debug(args)
+	res.split_dwarf = self:_split_dwarf(args)
 	res.debug_runtime = self:_debug_runtime(args)
 	res.exception = self:_exception(args)
 	res.warnings = self:_warnings(args)
 	res.optimization = self:_optimization(args)
+	res.lto = self:_lto(args)
+	if args.pgo ~= nil then
+		-- Profiles are named after the object path relative to this one.
+		res.pgo = table.update(
+			{prefix = self:_absolute_target_path(res.object_directory)}, args.pgo
+		)
+	end
 	res.big_object = self:_big_object(args)
 	res.runtime = self:_runtime(args)
 	return res
@@ -484,37 +706,282 @@ end
 function M:_build_objects(args)
 	args = self:_normalize_build_object_args(args)
 	local objects = {}
-	for idx, source in ipairs(args.sources) do
+	local header = args.precompiled_header or self.precompiled_header
+	if header ~= nil then
+		args.precompiled = self:_add_precompiled_header(args, header)
+		table.extend(objects, args.precompiled.objects)
+	end
+	local sources = {}
+	for _, source in ipairs(args.sources) do
 		if getmetatable(source) ~= Node then
 			source = self.build:source_node(Path:new(source))
 		end
-		source:set_property('language', self.lang)
-		source:set_property('include_directories', args.include_directories)
-
+		table.append(sources, source)
+	end
+	local units
+	if self:_unity_build(args) then
+		units = self:_unity_units(args, sources)
+	else
+		units = {}
+		for _, source in ipairs(sources) do
+			table.append(units, {
+				source = source,
+				target = args.object_directory / (
+					source:relative_path(self.build:project_directory()) +
+					args.object_extension
+				),
+			})
+		end
+	end
+	for _, unit in ipairs(units) do
+		unit.source:set_property('language', self.lang)
+		unit.source:set_property('include_directories', args.include_directories)
 		local res = self:_build_object(
 			table.update({
-				source = source:path(),
-				target = self.build:target_node(
-					args.object_directory / (
-						source:relative_path(self.build:project_directory()) +
-						args.object_extension
-					)
-				):path(),
+				source = unit.source:path(),
+				target = self.build:target_node(unit.target):path(),
 			}, args)
 		)
-		objects[idx] = self.build:target_node(res.targets[1])
-
-		local rule = Rule:new()
-			:add_sources(tools.normalize_files(self.build, res.sources))
-			:add_targets(tools.normalize_files(self.build, res.targets))
-		for _, cmd in ipairs(res.commands) do
-			rule:add_shell_command(ShellCommand:new(table.unpack(cmd)))
+		if args.precompiled ~= nil then
+			table.append(res.sources, args.precompiled.target)
 		end
-		self.build:add_rule(rule)
+		if args.pgo ~= nil and not args.pgo.generate then
+			table.append(res.sources, args.pgo.profile)
+		end
+		table.append(objects, self.build:target_node(res.targets[1]))
+		self:_add_object_rule(res)
 	end
 	return objects
 end
 
+--- Pass the arguments of a long command in a response file.
+--
+-- Commands not longer than the `RESPONSE_FILE_THRESHOLD` option are kept as
+-- is. Otherwise the response file is written when configuring (only when its
+-- content changes) and added to the rule sources.
+--
+-- @param rule Rule running the command
+-- @param target Node generated by the command
+-- @param command List of arguments
+-- @param[opt] keep Number of leading arguments kept on the command line
+-- (defaults to 1, the program)
+-- @return The command to run and whether a response file is used
+function M:_response_file_command(rule, target, command, keep)
+	keep = keep or 1
+	local threshold = self:_response_file_threshold()
+	if threshold <= 0 then return command, false end
+	local arguments, length = {}, 0
+	for i, arg in ipairs(command) do
+		if type(arg) ~= 'string' then arg = tostring(tools.path(arg)) end
+		arguments[i] = arg
+		length = length + #arg + 1
+	end
+	if length <= threshold then return command, false end
+
+	local lines = {}
+	for i = keep + 1, #arguments do
+		table.append(lines, self:_response_file_quote(arguments[i]))
+	end
+	local path = self.build:directory() / '.build' / 'rsp' /
+		(target:relative_path(self.build:directory()) + '.rsp')
+	tools.write_file(self.build, path, table.concat(lines, '\n') .. '\n')
+	rule:add_source(self.build:file_node(path))
+	local res = {}
+	for i = 1, keep do res[i] = command[i] end
+	table.append(res, '@' .. tostring(path))
+	return res, true
+end
+
+--- Quote an argument of a response file.
+function M:_response_file_quote(arg)
+	if not arg:find('[%s"\'\\]') then return arg end
+	return '"' .. (arg:gsub('[\\"]', '\\%0')) .. '"'
+end
+
+--- Absolute path of a path relative to the build directory.
+function M:_absolute_target_path(path)
+	path = Path:new(path)
+	if path:is_absolute() then return path end
+	return self.build:directory() / path
+end
+
+--- Add the first stages of a profile guided optimization.
+--
+-- The instrumented executable is built in the "pgo/<name>" object
+-- directory, and the training command is run to produce the profile used by
+-- the optimized build.
+--
+-- @param args Arguments of @{link_executable}
+-- @param link_args Arguments of the optimized executable link
+-- @return The profile informations given to the optimized build
+function M:_add_profile_guided_optimization(args, link_args)
+	local directory = Path:new(args.object_directory or self.object_directory) /
+		'pgo' / args.name
+	local pgo = {
+		generate = true,
+		directory = self:_absolute_target_path(directory / 'profiles'),
+	}
+	local instrumented = self:_link_executable(table.update(
+		table.update({}, link_args),
+		{
+			objects = self:_build_objects(table.update(
+				table.update({}, args),
+				{object_directory = directory, pgo = pgo}
+			)),
+			target = self.build:target_node(
+				(directory / args.name) + self:_executable_extension(args.extension)
+			),
+			pgo = pgo,
+			split_dwarf = false,
+		}
+	))
+
+	local training = args.pgo_training
+	if type(training) == 'function' then
+		training = training(instrumented)
+	else
+		training = table.extend({instrumented}, training)
+	end
+	local profile = self:_profile_merge(pgo.directory)
+	local rule = Rule:new()
+		:add_source(instrumented)
+		:add_target(self.build:target_node(profile.path))
+		-- Profiles of previous trainings would be accumulated.
+		:add_shell_command(ShellCommand:new(
+			self.build:configure_program(), '-E', 'remove', pgo.directory
+		))
+		:add_shell_command(ShellCommand:new(table.unpack(training)))
+	for _, command in ipairs(profile.commands) do
+		rule:add_shell_command(ShellCommand:new(table.unpack(command)))
+	end
+	self.build:add_rule(rule)
+	return {
+		generate = false,
+		directory = pgo.directory,
+		profile = profile.path,
+	}
+end
+
+--- Group sources in unity sources.
+--
+-- Sources are sorted by path and a batch ends after a source whose path hash
+-- is a multiple of the batch size (or when the batch gets too big), so that
+-- adding or removing a source only changes its own batch. Batches of one
+-- source and excluded sources are compiled as usual.
+--
+-- @param args Normalized arguments of the target
+-- @param sources List of source nodes
+-- @return A list of compilation units (`source` node and `target` path)
+function M:_unity_units(args, sources)
+	local batch_size = self:_unity_batch_size(args)
+	local excluded = {}
+	for _, source in ipairs(args.unity_exclude or self.unity_exclude) do
+		if getmetatable(source) ~= Node then
+			source = self.build:source_node(Path:new(source))
+		end
+		excluded[tostring(source:path())] = true
+	end
+	local project_directory = self.build:project_directory()
+	local sorted, units = {}, {}
+	for _, source in ipairs(sources) do
+		local relative_path = source:relative_path(project_directory)
+		local unit = {
+			source = source,
+			target = args.object_directory / (relative_path + args.object_extension),
+		}
+		if excluded[tostring(source:path())] then
+			table.append(units, unit)
+		else
+			unit.key = tostring(relative_path):gsub('\\', '/')
+			table.append(sorted, unit)
+		end
+	end
+	table.sort(sorted, function(a, b) return a.key < b.key end)
+
+	local batches, batch = {}, {}
+	for _, unit in ipairs(sorted) do
+		table.append(batch, unit)
+		if #batch >= 2 * batch_size or
+			tonumber(unit.key:sha256():sub(1, 8), 16) % batch_size == 0 then
+			table.append(batches, batch)
+			batch = {}
+		end
+	end
+	if #batch > 0 then table.append(batches, batch) end
+
+	local extension = self.lang == 'c' and '.c' or '.cpp'
+	for _, batch in ipairs(batches) do
+		if #batch == 1 then
+			table.append(units, batch[1])
+		else
+			local path = args.object_directory / 'unity' /
+				(args.name or 'objects') / (batch[1].key .. '.unity' .. extension)
+			local source = self.build:target_node(path)
+			local directory = source:path():parent_path()
+			local lines = {}
+			for _, unit in ipairs(batch) do
+				table.append(lines, '#include "' ..
+					tostring(unit.source:relative_path(directory)):gsub('\\', '/') .. '"')
+			end
+			tools.write_file(self.build, source:path(), table.concat(lines, '\n') .. '\n')
+			table.append(units, {
+				source = source,
+				target = path + args.object_extension,
+			})
+		end
+	end
+	return units
+end
+
+function M:_add_object_rule(res)
+	local rule = Rule:new()
+		:add_sources(tools.normalize_files(self.build, res.sources))
+		:add_targets(tools.normalize_files(self.build, res.targets))
+	for _, cmd in ipairs(res.commands) do
+		rule:add_shell_command(ShellCommand:new(table.unpack(cmd)))
+	end
+	self.build:add_rule(rule)
+end
+
+--- Compile the precompiled header of a target.
+--
+-- The header is included by a wrapper generated in the object directory,
+-- the precompiled header is stored next to it. Compilers fall back on the
+-- wrapper when they cannot use the precompiled header.
+--
+-- @param args Normalized arguments of the target
+-- @param header The header path or node
+-- @return A table with the `header`, `source` (the wrapper) and `target`
+-- paths, and the `objects` to link.
+function M:_add_precompiled_header(args, header)
+	if getmetatable(header) ~= Node then
+		header = self.build:source_node(Path:new(header))
+	end
+	header:set_property('language', self.lang)
+	header:set_property('include_directories', args.include_directories)
+	local source = self.build:target_node(
+		args.object_directory / 'pch' / (args.name or 'objects') /
+		header:relative_path(self.build:project_directory())
+	):path()
+	tools.write_file(
+		self.build, source,
+		'#include "' .. tostring(header:path()):gsub('\\', '/') .. '"\n'
+	)
+	local pch = {
+		header = header:path(),
+		source = source,
+		target = source + self:_precompiled_header_extension(),
+		objects = {},
+	}
+	local res = self:_build_precompiled_header(table.update({precompiled = pch}, args))
+	table.append(res.sources, header)
+	for _, object in ipairs(res.objects or {}) do
+		table.append(pch.objects, self.build:target_node(object))
+	end
+	self:_add_object_rule(res)
+	return pch
+end
+
 --- Concat and normalize include directories from argument, libraries
 --  arguments compiler and compiler libraries.
 --
@@ -702,6 +1169,45 @@ function M:_big_object(args)
 	end
 end
 
+--- Split debug informations state
+--
+-- @param args
+-- @tparam[opt] bool args.split_dwarf
+-- @treturn bool
+function M:_split_dwarf(args)
+	if args.split_dwarf ~= nil then return args.split_dwarf end
+	if self.split_dwarf ~= nil then return self.split_dwarf end
+	return self.build:bool_option(
+		'SPLIT_DWARF', 'Put debug informations in .dwo files (gcc and clang)', false
+	)
+end
+
+--- Unity build state
+--
+-- @param args
+-- @tparam[opt] bool args.unity_build
+-- @treturn bool
+function M:_unity_build(args)
+	if args.unity_build ~= nil then return args.unity_build end
+	if self.unity_build ~= nil then return self.unity_build end
+	return self.build:bool_option(
+		'UNITY_BUILD', 'Compile sources in batches (unity build)', false
+	)
+end
+
+--- Unity build batch size
+--
+-- @param args
+-- @tparam[opt] int args.unity_batch_size
+-- @treturn int
+function M:_unity_batch_size(args)
+	local res = args.unity_batch_size or self.unity_batch_size or
+		self.build:int_option(
+			'UNITY_BUILD_BATCH_SIZE', 'Average number of sources per unity source', 8
+		)
+	return math.max(1, math.tointeger(res) or 1)
+end
+
 --- warnings state
 --
 -- @param args
@@ -747,6 +1253,82 @@ function M:_optimization(args)
 	return lvl
 end
 
+--- Link time optimization mode
+--
+-- @param args
+-- @tparam[opt] string|bool args.lto
+-- @treturn string|bool "thin", "full" or false
+function M:_lto(args)
+	local mode = args.lto
+	if mode == nil then mode = self.lto end
+	if mode == nil then
+		mode = self.build:string_option(
+			'LTO', 'Link time optimization (thin, full or empty)', ''
+		)
+	end
+	if mode == true then return 'full' end
+	if not mode or mode == '' or mode == 'no' then return false end
+	if mode ~= 'thin' and mode ~= 'full' then
+		self.build:error("Invalid value for the lto argument: " .. tostring(mode))
+	end
+	return mode
+end
+
+--- Number of link time optimization jobs, 0 lets the compiler decide.
+--
+-- @treturn int
+function M:_lto_jobs()
+	return math.max(0, math.tointeger(self.build:int_option(
+		'LTO_JOBS', 'Parallel link time optimization jobs (0 for automatic)', 0
+	)) or 0)
+end
+
+--- Length of the commands from which arguments are passed in a response
+-- file, 0 disables response files.
+--
+-- @treturn int
+function M:_response_file_threshold()
+	return math.tointeger(self.build:int_option(
+		'RESPONSE_FILE_THRESHOLD',
+		'Command length from which arguments are passed in a file (0 to disable)',
+		8192
+	)) or 0
+end
+
+--- Thin archive state
+--
+-- @param args
+-- @tparam string args.kind
+-- @tparam[opt] bool args.thin_archive
+-- @treturn bool
+function M:_thin_archive(args)
+	if args.kind ~= 'static' or self:_install_library(args, 'static') then
+		return false
+	end
+	if args.thin_archive ~= nil then return args.thin_archive end
+	if self.thin_archive ~= nil then return self.thin_archive end
+	return self.build:bool_option(
+		'THIN_ARCHIVES', 'Static libraries only reference their objects', false
+	)
+end
+
+--- Profile guided optimization state
+--
+-- Only targets with a training command are optimized, when the `PGO` option
+-- is set and the optimization level is not "no".
+--
+-- @param args
+-- @tparam[opt] table|function args.pgo_training
+-- @treturn bool
+function M:_pgo(args)
+	if args.pgo_training == nil or self:_optimization(args) == 'no' then
+		return false
+	end
+	return self.build:bool_option(
+		'PGO', 'Profile guided optimization of targets with a training command', true
+	)
+end
+
 --- Unresolved symbols policy
 -- @param args
 -- @tparam[opt] bool args.allow_unresolved_symbols
@@ -839,13 +1421,64 @@ function M:find_tool(var_name, description, default_value)
 	return self.build:file_node(path)
 end
 
+--- Program prepended to compile commands (like ccache or sccache).
+--
+-- It is set with the COMPILER_LAUNCHER option, or the first program of
+-- `launcher_names` found. An empty value disables it.
+--
+-- @treturn Node|nil
+function M:launcher()
+	if self._launcher == nil then
+		local value = self.build:lazy_string_option(
+			'COMPILER_LAUNCHER',
+			'Program prepended to compile commands (like ccache or sccache)',
+			function ()
+				for _, name in ipairs(self.launcher_names) do
+					local path = self.build:fs():which(name)
+					if path ~= nil then return tostring(path) end
+				end
+				return ''
+			end
+		)
+		self._launcher = false
+		if value ~= '' then
+			local path = Path:new(value)
+			if not path:is_absolute() then
+				path = self.build:fs():which(value)
+				if path == nil then
+					self.build:error("Couldn't find the compiler launcher '" .. value .. "'")
+				end
+			end
+			self.build:debug("Using compiler launcher", path)
+			self._launcher = self.build:file_node(path)
+		end
+	end
+	return self._launcher or nil
+end
+
+--- First arguments of compile commands: the launcher, if any, and the
+-- compiler binary.
+function M:_compile_command()
+	local launcher = self:launcher()
+	if launcher ~= nil then return {launcher, self.binary} end
+	return {self.binary}
+end
+
 --- System include directories used by the compiler implicitly
 --
 -- @return A list of directories
 function M:system_include_directories()
 	return self.binary:set_cached_property(
 		self.env_name .. "-system-include-directories",
-		function () return self:_system_include_directories() end
+		function ()
+			return self:_shared_probe(
+				'system-include-directories',
+				self:_system_directories_input(
+					self:_system_include_directories_command()
+				),
+				function () return self:_system_include_directories() end
+			)
+		end
 	)
 end
 
@@ -855,10 +1488,40 @@ end
 function M:system_library_directories()
 	return self.binary:set_cached_property(
 		self.env_name .. "-system-library-directories",
-		function () return self:_system_library_directories() end
+		function ()
+			return self:_shared_probe(
+				'system-library-directories',
+				self:_system_directories_input(
+					self:_system_library_directories_command()
+				),
+				function () return self:_system_library_directories() end
+			)
+		end
 	)
 end
 
+--- Environment variables changing the system directories of the compiler.
+M.system_directories_variables = {
+	'CPATH', 'C_INCLUDE_PATH', 'CPLUS_INCLUDE_PATH', 'LIBRARY_PATH',
+}
+
+--- What the system directories depend on besides the compiler identity:
+-- the language, the environment and the probe command, which holds the
+-- flags like --sysroot or the target ones.
+function M:_system_directories_input(command)
+	local res = {self.lang}
+	for _, var in ipairs(self.system_directories_variables) do
+		table.append(res, var .. '=' .. (os.getenv(var) or ''))
+	end
+	for _, arg in ipairs(command) do
+		if type(arg) == 'table' or type(arg) == 'userdata' then
+			arg = tools.path(arg)
+		end
+		table.append(res, tostring(arg))
+	end
+	return table.concat(res, '\n')
+end
+
 --- Implementation API methods
 --
 -- These methods are implemented in final classes.
@@ -873,6 +1536,11 @@ end
 -- @param args.defines A list of defines
 -- @param args.standard
 -- @param args.coverage Coverage state
+-- @param args.precompiled Precompiled header to use (see
+-- `_add_precompiled_header()`)
+-- @param args.pgo Profile guided optimization stage (see
+-- `_add_profile_guided_optimization()`), with the absolute object directory
+-- as `prefix`
 function M:_build_object(args)
 	error("Not implemented")
 end
@@ -901,6 +1569,31 @@ function M:_link_library(args)
 	error("Not implemented")
 end
 
+--- Compile a precompiled header.
+--
+-- @param args Same as `_build_object()`
+-- @param args.precompiled The precompiled header to build (see
+-- `_add_precompiled_header()`)
+-- @return A table with `sources`, `targets`, `commands` and the `objects`
+-- to link.
+function M:_build_precompiled_header(args)
+	error("Not implemented")
+end
+
+--- Extension of precompiled headers.
+function M:_precompiled_header_extension()
+	error("Not implemented")
+end
+
+--- Merge the profiles written by a training.
+--
+-- @param directory Where the instrumented executable writes its profiles
+-- @return A table with the `path` of the profile given to the optimized
+-- build and the `commands` producing it.
+function M:_profile_merge(directory)
+	error("Profile guided optimization is not supported by " .. self.name)
+end
+
 function M:_system_include_directories()
 	error("Not implemented")
 end
@@ -909,4 +1602,14 @@ function M:_system_library_directories()
 	error("Not implemented")
 end
 
+--- Command run by _system_include_directories(), if any.
+function M:_system_include_directories_command()
+	return {}
+end
+
+--- Command run by _system_library_directories(), if any.
+function M:_system_library_directories_command()
+	return {}
+end
+
 return M
@@ -6,6 +6,60 @@ local Compiler = table.update(
 )
 Compiler.name = 'clang'
 Compiler.binary_names = {'clang', }
+Compiler.lto_archiver_name = 'llvm-ar'
+
+function Compiler:_precompiled_header_extension()
+	return '.pch'
+end
+
+function Compiler:_add_precompiled_header_flag(cmd, args)
+	table.extend(cmd, {'-include-pch', args.precompiled.target})
+end
+
+function Compiler:_add_lto_flag(cmd, args)
+	if args.lto then
+		table.append(cmd, '-flto=' .. args.lto)
+	end
+end
+
+-- Thin LTO uses all the cores by default, and caches its results between
+-- links.
+function Compiler:_add_lto_linker_flags(cmd, args)
+	if not args.lto then return end
+	table.append(cmd, '-flto=' .. args.lto)
+	if args.lto ~= 'thin' then return end
+	local jobs = self:_lto_jobs()
+	if jobs > 0 then table.append(cmd, '-flto-jobs=' .. tostring(jobs)) end
+	local cache = tostring(self.build:directory() / '.build' / 'thinlto-cache')
+	if self.build:target():is_osx() then
+		table.append(cmd, '-Wl,-cache_path_lto,' .. cache)
+	elseif self:linker() == 'lld' then
+		table.append(cmd, '-Wl,--thinlto-cache-dir=' .. cache)
+	else
+		table.append(cmd, '-Wl,-plugin-opt,cache-dir=' .. cache)
+	end
+end
+
+function Compiler:_add_profile_flags(cmd, args)
+	local pgo = args.pgo
+	if pgo == nil then return end
+	if pgo.generate then
+		-- One file per process, merged after the training.
+		table.append(cmd, '-fprofile-instr-generate=' ..
+			tostring(pgo.directory / '%p-%m.profraw'))
+	else
+		table.append(cmd, '-fprofile-use=' .. tostring(pgo.profile))
+	end
+end
+
+function Compiler:_profile_merge(directory)
+	local path = directory + '.profdata'
+	local profdata = self:_find_compiler_tool('LLVM_PROFDATA', 'llvm-profdata')
+	return {
+		path = path,
+		commands = {{profdata, 'merge', '-o', path, directory}},
+	}
+end
 
 function Compiler:_gen_rpath_flags(dirs)
 	local res = {}
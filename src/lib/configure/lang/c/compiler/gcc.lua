@@ -11,10 +11,12 @@ Compiler.name = "gcc"
 Compiler.binary_names = {'gcc', }
 Compiler.lang = 'c'
 
+--- Archiver understanding LTO objects.
+Compiler.lto_archiver_name = 'gcc-ar'
+
 function Compiler:init()
 	BaseCompiler.init(self)
 	self.ar = self:find_tool("AR", "ar program", "ar")
-	self.ranlib = self:find_tool("RANLIB", "ranlib program", "ranlib")
 end
 
 Compiler._optimization_flags = {
@@ -29,8 +31,106 @@ function Compiler:_add_optimization_flag(cmd, args)
 	table.append(cmd, self._optimization_flags[args.optimization])
 end
 
+function Compiler:_add_lto_flag(cmd, args)
+	if args.lto then table.append(cmd, '-flto') end
+end
+
+-- GCC has no thin mode, the optimizations are partitioned and run by as
+-- many jobs as make allows (or the number of cores).
+function Compiler:_add_lto_linker_flags(cmd, args)
+	if not args.lto then return end
+	local jobs = self:_lto_jobs()
+	table.append(cmd, '-flto=' .. (jobs > 0 and tostring(jobs) or 'auto'))
+end
+
+--- Find a program shipped with the compiler, next to it first.
+function Compiler:_find_compiler_tool(var_name, name)
+	local binary = self.binary:path()
+	-- Versioned compilers like gcc-12 come with gcc-ar-12.
+	local suffix = tostring(binary:filename()):match('%-[%d.]+$') or ''
+	local default = binary:parent_path() / (name .. suffix)
+	if not default:exists() then default = name end
+	return self:find_tool(var_name, name .. ' program', default)
+end
+
+--- Archiver used for static libraries.
+--
+-- The compiler wrapper (see `lto_archiver_name`) is used with LTO.
+--
+-- @return ar node
+function Compiler:_archiver(args)
+	if not args.lto then return self.ar end
+	if self._lto_archiver == nil then
+		self._lto_archiver = self:_find_compiler_tool('LTO_AR', self.lto_archiver_name)
+	end
+	return self._lto_archiver
+end
+
+-- Profiles are named after the object paths relative to the object
+-- directory (GCC >= 11), so that both stages find the same files.
+function Compiler:_add_profile_flags(cmd, args)
+	local pgo = args.pgo
+	if pgo == nil then return end
+	if pgo.generate then
+		table.append(cmd, '-fprofile-generate=' .. tostring(pgo.directory))
+	else
+		table.append(cmd, '-fprofile-use=' .. tostring(pgo.directory))
+	end
+	if pgo.prefix ~= nil then
+		if not self:_supports_profile_prefix_path() then
+			self.build:error(
+				"Profile guided optimization requires GCC 11 or later, '" ..
+				tostring(tools.path(self.binary)) ..
+				"' does not support -fprofile-prefix-path"
+			)
+		end
+		table.append(cmd, '-fprofile-prefix-path=' .. tostring(pgo.prefix))
+	end
+end
+
+--- Check that the compiler supports `-fprofile-prefix-path` (GCC 11).
+function Compiler:_supports_profile_prefix_path()
+	if self._profile_prefix_path == nil then
+		self._profile_prefix_path = self:_shared_probe('fprofile-prefix-path', '', function ()
+			local dir = TemporaryDirectory:new()
+			local source = dir:path() / 'main.c'
+			local f = assert(io.open(tostring(source), 'w'))
+			f:write('int main() { return 0; }\n')
+			f:close()
+			return Process:call(
+				{
+					self.binary, '-fprofile-generate',
+					'-fprofile-prefix-path=' .. tostring(dir:path()),
+					'-c', source, '-o', dir:path() / 'main.o'
+				},
+				{stdout = Process.Stream.DEVNULL, stderr = Process.Stream.DEVNULL}
+			) == 0
+		end)
+	end
+	return self._profile_prefix_path
+end
+
+-- The instrumented executable merges its counters in the .gcda files, the
+-- profile is a stamp file.
+function Compiler:_profile_merge(directory)
+	local path = directory + '.stamp'
+	return {
+		path = path,
+		commands = {{self.build:configure_program(), '-E', 'touch', path}},
+	}
+end
+
 function Compiler:_add_language_flag(cmd, args)
-	table.extend(cmd, {'-x', self.lang})
+	if args.precompile then
+		table.extend(cmd, {'-x', self.lang .. '-header'})
+	else
+		table.extend(cmd, {'-x', self.lang})
+	end
+end
+
+-- GCC looks for "<header>.gch" when including "<header>".
+function Compiler:_add_precompiled_header_flag(cmd, args)
+	table.extend(cmd, {'-include', args.precompiled.source})
 end
 
 function Compiler:_add_standard_flag(cmd, args)
@@ -48,7 +148,28 @@ function Compiler:_add_coverage_flag(cmd, args)
 end
 
 function Compiler:_add_debug_flag(cmd, args)
-	if args.debug then table.insert(cmd, '-g') end
+	if not args.debug then return end
+	table.insert(cmd, '-g')
+	if args.split_dwarf and not args.precompile then
+		table.insert(cmd, '-gsplit-dwarf')
+		local dwp = self:_dwarf_package_tool()
+		if dwp ~= nil and not tostring(dwp:path():filename()):starts_with('llvm') then
+			-- GNU dwp does not support DWARF 5.
+			table.insert(cmd, '-gdwarf-4')
+		end
+	end
+	if self:_linker_option('GDB_INDEX') then
+		-- Used by the linker to build the index.
+		table.insert(cmd, '-ggnu-pubnames')
+	end
+	if self:launcher() ~= nil then
+		-- The working directory is recorded in the debug informations,
+		-- objects are then cached for one build directory only.
+		table.insert(
+			cmd,
+			'-fdebug-prefix-map=' .. tostring(self.build:directory()) .. '=.'
+		)
+	end
 end
 
 function Compiler:_add_warnings_flag(cmd, args)
@@ -56,10 +177,12 @@ function Compiler:_add_warnings_flag(cmd, args)
 end
 
 function Compiler:_build_object(args)
-	local command = {self.binary}
+	local command = self:_compile_command()
 
 	self:_add_language_flag(command, args)
 	self:_add_optimization_flag(command, args)
+	self:_add_lto_flag(command, args)
+	self:_add_profile_flags(command, args)
 	self:_add_standard_flag(command, args)
 	self:_add_standard_library_flag(command, args)
 	self:_add_coverage_flag(command, args)
@@ -80,17 +203,81 @@ function Compiler:_build_object(args)
 	end
 	table.extend(command, tools.unique(defines))
 
+	if args.precompiled ~= nil and not args.precompile then
+		self:_add_precompiled_header_flag(command, args)
+	end
 	for _, file in ipairs(args.include_files) do
 		table.extend(command, {'-include', file})
 	end
 	table.extend(command, {"-c", args.source, '-o', args.target})
+	local targets = {args.target}
+	if args.debug and args.split_dwarf and not args.precompile then
+		-- The extension of the object is replaced.
+		local target = tools.path(args.target)
+		table.append(targets, target:parent_path() / (tostring(target:stem()) .. '.dwo'))
+	end
 	return {
 		sources = table.extend({args.source}, args.install_nodes),
-		targets = {args.target},
+		targets = targets,
 		commands = {command}
 	}
 end
 
+--- Probe all headers with `__has_include` in one preprocessor run, fall
+-- back to compilations when the compiler does not support it.
+function Compiler:_probe_has_includes(names, args)
+	local normalized = self:_normalize_build_object_args(args)
+	local dir = TemporaryDirectory:new()
+	local content = {'#ifdef __has_include'}
+	for idx, name in ipairs(names) do
+		table.extend(content, {
+			'# if __has_include(<' .. name .. '>)',
+			'configure_has_include ' .. idx .. ' 1',
+			'# else',
+			'configure_has_include ' .. idx .. ' 0',
+			'# endif',
+		})
+	end
+	table.append(content, '#endif')
+	normalized.source = dir:path() / 'has-includes.c'
+	normalized.target = dir:path() / 'has-includes.i'
+	local command = {}
+	for _, arg in ipairs(self:_build_object(normalized).commands[1]) do
+		if arg == '-c' then
+			table.extend(command, {'-E', '-P'})
+		else
+			table.append(command, arg)
+		end
+	end
+	if self:_compile_probe(normalized.source, table.concat(content, '\n'), {command}) then
+		local res = {}
+		local f = assert(io.open(tostring(normalized.target), 'r'))
+		for line in f:lines() do
+			local idx, found = line:match('^configure_has_include (%d+) ([01])')
+			if idx then res[names[tonumber(idx)]] = (found == '1') end
+		end
+		f:close()
+		local complete = true
+		for _, name in ipairs(names) do
+			if res[name] == nil then complete = false end
+		end
+		if complete then return res end
+	end
+	return BaseCompiler._probe_has_includes(self, names, args)
+end
+
+function Compiler:_precompiled_header_extension()
+	return '.gch'
+end
+
+function Compiler:_build_precompiled_header(args)
+	return self:_build_object(table.update(table.update({}, args), {
+		source = args.precompiled.source,
+		target = args.precompiled.target,
+		precompile = true,
+	}))
+end
+
 function Compiler:_add_rpath_flag(cmd, args)
 	local shared_library_files = {}
 	for _, lib in ipairs(args.libraries) do
@@ -140,13 +327,96 @@ function Compiler:_add_export_dynamic_flag(cmd, args)
 	end
 end
 
+--- Linkers detected, by order of preference, when LINKER is not set.
+Compiler.linker_names = {'mold', 'lld', 'gold'}
+
+local linker_binaries = {mold = 'mold', lld = 'ld.lld', gold = 'ld.gold'}
+
+--- Linker selected with `-fuse-ld`.
+--
+-- It is set with the LINKER option, or the first linker of `linker_names`
+-- installed and supported by the compiler. An empty value selects the
+-- default linker.
+--
+-- @treturn string|nil
+function Compiler:linker()
+	if self._linker == nil then
+		self._linker = false
+		if self.build:host():os() == Platform.OS.osx then return nil end
+		local value = self.build:lazy_string_option(
+			'LINKER',
+			'Linker used by the compiler (mold, lld, gold or empty for the default one)',
+			function ()
+				for _, name in ipairs(self.linker_names) do
+					if self.build:fs():which(linker_binaries[name]) ~= nil and
+						self:_supports_linker(name) then
+						return name
+					end
+				end
+				return ''
+			end
+		)
+		if value ~= '' then
+			self.build:debug("Using linker", value)
+			self._linker = value
+		end
+	end
+	return self._linker or nil
+end
+
+--- Check that a trivial program links with `-fuse-ld=<name>`.
+function Compiler:_supports_linker(name)
+	return self:_shared_probe('fuse-ld', name, function ()
+		local dir = TemporaryDirectory:new()
+		local source = dir:path() / 'main.c'
+		local f = assert(io.open(tostring(source), 'w'))
+		f:write('int main() { return 0; }\n')
+		f:close()
+		return Process:call(
+			{self.binary, '-fuse-ld=' .. name, source, '-o', dir:path() / 'main'},
+			{stdout = Process.Stream.DEVNULL, stderr = Process.Stream.DEVNULL}
+		) == 0
+	end)
+end
+
+--- Linker tuning enabled by the LINKER_<NAME> options (only with a linker
+-- selected by LINKER).
+function Compiler:_linker_option(name)
+	if self:linker() == nil then return false end
+	local descriptions = {
+		THREADS = 'Link with multiple threads (gold)',
+		GDB_INDEX = 'Build a .gdb_index section in debug builds',
+		ICF = 'Fold identical code sections (--icf=all)',
+	}
+	return self.build:bool_option('LINKER_' .. name, descriptions[name], false)
+end
+
+function Compiler:_add_linker_selection_flags(cmd, args)
+	local linker = self:linker()
+	if linker == nil then return end
+	table.append(cmd, '-fuse-ld=' .. linker)
+	-- lld and mold use all the cores by default.
+	if linker == 'gold' and self:_linker_option('THREADS') then
+		table.append(cmd, '-Wl,--threads')
+	end
+	if args.debug and self:_linker_option('GDB_INDEX') then
+		table.append(cmd, '-Wl,--gdb-index')
+	end
+	if self:_linker_option('ICF') then
+		table.append(cmd, '-Wl,--icf=all')
+	end
+end
+
 -- Generic linker flags generation
 function Compiler:_add_linker_flags(cmd, args, sources)
+	self:_add_linker_selection_flags(cmd, args)
 	self:_add_standard_flag(cmd, args)
 	self:_add_standard_library_flag(cmd, args)
 	self:_add_export_dynamic_flag(cmd, args)
 	self:_add_coverage_flag(cmd, args)
 	self:_add_optimization_flag(cmd, args)
+	self:_add_lto_linker_flags(cmd, args)
+	self:_add_profile_flags(cmd, args)
 	self:_add_unresolved_symbols_policy_flag(cmd, args)
 	self:_add_rpath_flag(cmd, args)
 end
@@ -247,25 +517,64 @@ function Compiler:_link_executable(args)
 	self:_add_linker_library_flags(command, args, sources)
 
 	table.extend(command, {"-o", args.target})
-	self.build:add_rule(
-		Rule:new()
-			:add_sources(args.objects)
-			:add_sources(sources)
-			:add_target(args.target)
-			:add_shell_command(ShellCommand:new(table.unpack(command)))
-	)
+	local rule = Rule:new()
+		:add_sources(args.objects)
+		:add_sources(sources)
+		:add_target(args.target)
+	command = self:_response_file_command(rule, args.target, command)
+	rule:add_shell_command(ShellCommand:new(table.unpack(command)))
+	self:_add_dwarf_package_command(rule, args)
+	self.build:add_rule(rule)
 	return args.target
 end
 
+--- The dwp program when the SPLIT_DWARF_PACKAGE option is set.
+--
+-- @treturn Node|nil
+function Compiler:_dwarf_package_tool()
+	if self._dwp == nil then
+		self._dwp = self.build:bool_option(
+			'SPLIT_DWARF_PACKAGE', 'Package the .dwo files of linked targets (dwp)', false
+		) and self:find_tool('DWP', 'dwp program', 'dwp')
+	end
+	return self._dwp or nil
+end
+
+--- Package the .dwo files of a linked target.
+function Compiler:_add_dwarf_package_command(rule, args)
+	if not (args.debug and args.split_dwarf) then return end
+	local dwp = self:_dwarf_package_tool()
+	if dwp == nil then return end
+	local package = self.build:file_node(args.target:path() + '.dwp')
+	rule:add_target(package)
+		:add_shell_command(ShellCommand:new(dwp, '-e', args.target, '-o', package))
+end
+
 function Compiler:_link_library(args)
 	if args.kind == 'static' then
-		self.build:add_rule(
-			Rule:new()
-				:add_sources(args.objects)
-				:add_target(args.target)
-				:add_shell_command(ShellCommand:new(self.ar, 'rcs', args.target, table.unpack(args.objects)))
-				:add_shell_command(ShellCommand:new(self.ranlib, args.target))
-		)
+		-- The 's' modifier writes the index, ranlib is not needed. Thin
+		-- archives only reference the objects, and are much faster to update.
+		local modifiers = 'rcs'
+		if args.thin_archive and self.build:host():os() ~= Platform.OS.osx then
+			modifiers = 'rcsT'
+		end
+		local rule = Rule:new()
+			:add_sources(args.objects)
+			:add_target(args.target)
+		local command = {
+			self:_archiver(args), modifiers, args.target, table.unpack(args.objects)
+		}
+		-- The cctools ar of OS X does not read response files.
+		if self.build:host():os() ~= Platform.OS.osx then
+			command = self:_response_file_command(rule, args.target, command, 3)
+		end
+		-- 'ar r' updates an existing archive: removed objects would stay in
+		-- it, and it refuses to mix thin and normal archives.
+		rule:add_shell_command(ShellCommand:new(
+			self.build:configure_program(), '-E', 'remove', args.target
+		))
+		rule:add_shell_command(ShellCommand:new(table.unpack(command)))
+		self.build:add_rule(rule)
 	else
 		assert(args.kind == 'shared')
 		local command = { self.binary,}
@@ -285,13 +594,14 @@ function Compiler:_link_library(args)
 		table.extend(command, args.objects)
 		self:_add_linker_library_flags(command, args, sources)
 		table.extend(command, {"-o", args.target})
-		self.build:add_rule(
-			Rule:new()
-				:add_sources(args.objects)
-				:add_sources(sources)
-				:add_target(args.target)
-				:add_shell_command(ShellCommand:new(table.unpack(command)))
-		)
+		local rule = Rule:new()
+			:add_sources(args.objects)
+			:add_sources(sources)
+			:add_target(args.target)
+		command = self:_response_file_command(rule, args.target, command)
+		rule:add_shell_command(ShellCommand:new(table.unpack(command)))
+		self:_add_dwarf_package_command(rule, args)
+		self.build:add_rule(rule)
 	end
 	return self.Library:new{
 		name = args.name,
@@ -301,9 +611,13 @@ function Compiler:_link_library(args)
 	}
 end
 
+function Compiler:_system_include_directories_command()
+	return {self.binary, '-E', '-x', 'c++', '-', '-v'}
+end
+
 function Compiler:_system_include_directories()
 	local out = Process:check_output(
-		{self.binary, '-E', '-x', 'c++', '-', '-v'},
+		self:_system_include_directories_command(),
 		{
 			stdin = Process.Stream.DEVNULL,
 			stderr = Process.Stream.PIPE,
@@ -332,9 +646,7 @@ function Compiler:_system_include_directories()
 	return res
 end
 
-
-
-function Compiler:_system_library_directories()
+function Compiler:_system_library_directories_command()
 	local cmd = {self.binary,  '-Xlinker', '--verbose'}
 	if self.name == 'clang' then
 		if self.build:host():os() == Platform.OS.osx then
@@ -343,10 +655,14 @@ function Compiler:_system_library_directories()
 			cmd = { self.binary, '-Xlinker', '--verbose' }
 		end
 	end
-	self:_add_language_flag(cmd)
+	self:_add_language_flag(cmd, {})
 	table.append(cmd, '/dev/null')
+	return cmd
+end
+
+function Compiler:_system_library_directories()
 	local out = Process:check_output(
-		cmd,
+		self:_system_library_directories_command(),
 		{
 			stdin = Process.Stream.DEVNULL,
 			stderr = Process.Stream.PIPE,
@@ -7,6 +7,7 @@ local Compiler = table.update({}, Super)
 
 Compiler.name = 'msvc'
 Compiler.binary_names = {'cl.exe', }
+Compiler.launcher_names = {'sccache', }
 Compiler.lang = 'c'
 Compiler._language_flag = '-TC'
 
@@ -66,7 +67,11 @@ function Compiler:_add_optimization_flag(cmd, args)
 end
 
 function Compiler:_build_object(args)
-	local command = { self.binary_path, '-nologo', self._language_flag }
+	-- Debug informations are always embedded (-Z7), as required by
+	-- compiler launchers.
+	local command = table.extend(
+		self:_compile_command(), {'-nologo', self._language_flag}
+	)
 	self:_add_optimization_flag(command, args)
 	if args.exception == true then
 		table.append(command, '-EHsc')
@@ -80,6 +85,10 @@ function Compiler:_build_object(args)
 	if args.big_object then
 		table.append(command, '-bigobj')
 	end
+	-- Whole program optimization (there is no thin mode).
+	if args.lto then
+		table.append(command, '-GL')
+	end
 
 	local defines = table.extend({}, args.defines)
 	local runtime_flag = nil
@@ -116,6 +125,14 @@ function Compiler:_build_object(args)
 	end
 	table.extend(command, tools.unique(define_args))
 
+	if args.precompiled ~= nil then
+		local pch = args.precompiled
+		table.extend(command, {
+			(args.precompile and '-Yc' or '-Yu') .. tostring(pch.source),
+			'-FI' .. tostring(pch.source),
+			'-Fp' .. tostring(pch.target),
+		})
+	end
 	for _, file in ipairs(args.include_files) do
 		table.extend(command, {'-FI', file})
 	end
@@ -128,6 +145,25 @@ function Compiler:_build_object(args)
 	}
 end
 
+function Compiler:_precompiled_header_extension()
+	return '.pch'
+end
+
+-- The precompiled header is created while compiling an empty source that
+-- force includes the wrapper, its object has to be linked.
+function Compiler:_build_precompiled_header(args)
+	local source = args.precompiled.source + (self.lang == 'c' and '.c' or '.cpp')
+	tools.write_file(self.build, source, '')
+	local res = self:_build_object(table.update(table.update({}, args), {
+		source = source,
+		target = source + self:_object_extension(),
+		precompile = true,
+	}))
+	table.append(res.targets, args.precompiled.target)
+	res.objects = {res.targets[1]}
+	return res
+end
+
 function Compiler:_add_linker_library_flags(command, args, sources)
 	local link_args = {}
 	for _, dir in ipairs(args.library_directories) do
@@ -177,17 +213,21 @@ function Compiler:_link_executable(args)
 	if args.coverage then
 		table.append(command, '-Profile')
 	end
+	if args.lto then
+		table.append(command, '-LTCG')
+	end
 
 	local library_sources = {}
 	self:_add_linker_library_flags(command, args, library_sources)
 	table.extend(command, args.objects)
 	table.append(command, "-OUT:" .. tostring(args.target:path()))
+	local rule = Rule:new()
+		:add_sources(args.objects)
+		:add_sources(tools.unique(library_sources))
+		:add_target(args.target)
+	command = self:_response_file_command(rule, args.target, command)
 	self.build:add_rule(
-		Rule:new()
-			:add_sources(args.objects)
-			:add_sources(tools.unique(library_sources))
-			:add_target(args.target)
-			:add_shell_command(ShellCommand:new(table.unpack(command)))
+		rule:add_shell_command(ShellCommand:new(table.unpack(command)))
 	)
 	return args.target
 end
@@ -217,16 +257,20 @@ function Compiler:_link_library(args)
 		'-nologo',
 		'-OUT:' .. tostring(args.target:path())
 	})
+	if args.lto then
+		table.append(command, '-LTCG')
+	end
 	local library_sources = {}
 	self:_add_linker_library_flags(command, args, library_sources)
 	table.extend(command, args.objects)
 
+	rule
+		:add_sources(args.objects)
+		:add_sources(library_sources)
+		:add_target(args.target)
+	command = self:_response_file_command(rule, args.target, command)
 	self.build:add_rule(
-		rule
-			:add_sources(args.objects)
-			:add_sources(library_sources)
-			:add_target(args.target)
-			:add_shell_command(ShellCommand:new(table.unpack(command)))
+		rule:add_shell_command(ShellCommand:new(table.unpack(command)))
 	)
 	return self.Library:new{
 		name = args.name,
@@ -236,6 +280,12 @@ function Compiler:_link_library(args)
 	}
 end
 
+-- Backslashes are only special before a double quote.
+function Compiler:_response_file_quote(arg)
+	if not arg:find('[%s"]') then return arg end
+	return '"' .. (arg:gsub('"', '\\"')) .. '"'
+end
+
 function Compiler:_library_extension(kind, ext, runtime)
 	if ext then return ext end
 	if runtime == true and kind == 'shared' then return '.dll' end
@@ -248,6 +298,16 @@ end
 
 local os = require('os')
 
+-- cl.exe has no version flag, its binary hash identifies it. System
+-- directories come from the environment.
+function Compiler:_version_output()
+	return table.concat({
+		os.getenv('INCLUDE') or '',
+		os.getenv('LIB') or '',
+		os.getenv('LIBPATH') or '',
+	}, '\n')
+end
+
 function Compiler:_system_include_directories()
     local res = {}
     table.extend(res, os.getenv('INCLUDE'):split(';'))
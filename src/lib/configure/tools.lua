@@ -72,14 +72,52 @@ function M.path(object)
 	error("Cannot convert '" .. tostring(object) .. "' to a Path")
 end
 
+--- Write a file generated when configuring.
+--
+-- The file is left untouched when its content did not change, so that
+-- nothing depending on it gets rebuilt. It is recorded with
+-- `Build:add_written_file()`.
+--
+-- @param build The build instance
+-- @tparam Path path Absolute path of the file
+-- @string content
+-- @treturn bool Whether the file was written
+function M.write_file(build, path, content)
+	local f = io.open(tostring(path), 'rb')
+	if f ~= nil then
+		local old = f:read('a')
+		f:close()
+		if old == content then
+			build:add_written_file(path)
+			return false
+		end
+	end
+	build:fs():create_directories(path:parent_path())
+	f = assert(io.open(tostring(path), 'wb'))
+	f:write(content)
+	f:close()
+	build:add_written_file(path)
+	return true
+end
+
+--- Remove duplicated values from a list, keeping the first occurrence.
+--
+-- Nodes always map to the same lua value, only paths need to be compared by
+-- value.
+--
+-- @param list
+-- @return a new list
 function M.unique(list)
 	local res = {}
+	local seen = {}
+	local seen_paths = {}
 	for _, v in ipairs(list) do
-		local found = false
-		for _, o in ipairs(res) do
-			if o == v then found = true; break end
+		local set, key = seen, v
+		if getmetatable(v) == Path then
+			set, key = seen_paths, tostring(v)
 		end
-		if not found then
+		if not set[key] then
+			set[key] = true
 			table.append(res, v)
 		end
 	end
@@ -45,3 +45,116 @@ Feature: C executable
 		When I configure and build
 		Then I can launch bin/hello-world.exe
 		And build/bin/hello-world.exe is a static executable
+
+	Scenario: Check many headers at once
+		Given a project configuration
+		"""
+		local c = require('configure.lang.c')
+
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local res = compiler:has_includes{'stdio.h', 'not/existing.h', 'stdlib.h'}
+			assert(res['stdio.h'] == true)
+			assert(res['not/existing.h'] == false)
+			assert(res['stdlib.h'] == true)
+			assert(compiler:has_include('stdlib.h'))
+		end
+		"""
+		When I configure the build
+		Then the build is configured
+
+	Scenario: Unity build
+		Given a project configuration
+		"""
+		local c = require('configure.lang.c')
+
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local exe = compiler:link_executable{
+				name = "hello-world",
+				sources = {'main.c', 'a.c', 'b.c', 'c.c'},
+				unity_build = true,
+				unity_batch_size = 2,
+				unity_exclude = {'c.c'},
+			}
+		end
+		"""
+		And a source file main.c
+		"""
+		int a(); int b(); int c();
+		int main() { return a() + b() + c() == 6 ? 0 : 1; }
+		"""
+		And a source file a.c
+		"""
+		int a() { return 1; }
+		"""
+		And a source file b.c
+		"""
+		int b() { return 2; }
+		"""
+		And a source file c.c
+		"""
+		static int value() { return 3; }
+		int c() { return value(); }
+		"""
+		When I configure and build
+		Then I can launch bin/hello-world
+
+	Scenario: Profile guided optimization
+		Given a project configuration
+		"""
+		local c = require('configure.lang.c')
+
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local exe = compiler:link_executable{
+				name = "hello-world",
+				sources = {'main.c', 'square.c'},
+				optimization = 'harder',
+				pgo_training = {'10'},
+			}
+		end
+		"""
+		And a source file main.c
+		"""
+		#include <stdlib.h>
+		int square(int);
+		int main(int ac, char** av)
+		{
+			int n = ac > 1 ? atoi(av[1]) : 3, s = 0;
+			for (int i = 0; i < n; ++i) s += square(i);
+			return s == n * (n - 1) * (2 * n - 1) / 6 ? 0 : 1;
+		}
+		"""
+		And a source file square.c
+		"""
+		int square(int i) { return i * i; }
+		"""
+		When I configure and build
+		Then I can launch bin/hello-world
+
+	Scenario: Split debug informations
+		Given a project configuration
+		"""
+		local c = require('configure.lang.c')
+
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local exe = compiler:link_executable{
+				name = "hello-world",
+				sources = {'main.c', },
+				debug = true,
+			}
+		end
+		"""
+		And a source file main.c
+		"""
+		#include <stdio.h>
+		int main() { printf("Hello, world!\n"); return 0; }
+		"""
+		When I configure with build SPLIT_DWARF=1
+		And I build everything
+		Then I can launch bin/hello-world
+		And build/main.c.dwo is a file
+		When I clean the build
+		Then build/main.c.dwo does not exist
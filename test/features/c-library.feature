@@ -70,3 +70,128 @@ Feature: C library
 		"""
 		When I configure and build
 		Then I can launch bin/test
+
+	Scenario: Static library with link time optimization
+		Given a source file my.c
+		"""
+		int my() { return 42; }
+		"""
+		And a source file test.c
+		"""
+		int my();
+		int main() { return my() == 42 ? 0 : 1; }
+		"""
+		And a project configuration
+		"""
+		local c = require('configure.lang.c')
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local libtest = compiler:link_static_library{
+				name = 'test',
+				sources = {'my.c'},
+				optimization = 'harder',
+				lto = 'full',
+			}
+			local exe = compiler:link_executable{
+				name = 'test',
+				sources = {'test.c'},
+				libraries = {libtest,},
+				optimization = 'harder',
+				lto = 'full',
+			}
+		end
+		"""
+		When I configure and build
+		Then I can launch bin/test
+
+	Scenario: Creating thin static library
+		Given a source file my.c
+		"""
+		int my() { return 42; }
+		"""
+		And a source file test.c
+		"""
+		int my();
+		int main() { return my() == 42 ? 0 : 1; }
+		"""
+		And a project configuration
+		"""
+		local c = require('configure.lang.c')
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local libtest = compiler:link_static_library{
+				name = 'test',
+				sources = {'my.c'},
+				thin_archive = true,
+			}
+			local exe = compiler:link_executable{
+				name = 'test',
+				sources = {'test.c'},
+				libraries = {libtest,},
+			}
+		end
+		"""
+		When I configure and build
+		Then I can launch bin/test
+
+	Scenario: Switching between thin and normal static libraries
+		Given a source file my.c
+		"""
+		int my() { return 42; }
+		"""
+		And a source file test.c
+		"""
+		int my();
+		int main() { return my() == 42 ? 0 : 1; }
+		"""
+		And a project configuration
+		"""
+		local c = require('configure.lang.c')
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local libtest = compiler:link_static_library{
+				name = 'test',
+				sources = {'my.c'},
+				thin_archive = build:bool_option('THIN', 'Thin archive', false),
+			}
+			local exe = compiler:link_executable{
+				name = 'test',
+				sources = {'test.c'},
+				libraries = {libtest,},
+			}
+		end
+		"""
+		When I configure and build
+		And I configure with build THIN=1
+		And I build everything
+		Then I can launch bin/test
+
+	Scenario: Linking with response files
+		Given a source file my.c
+		"""
+		int my() { return 42; }
+		"""
+		And a source file test.c
+		"""
+		int my();
+		int main() { return my() == 42 ? 0 : 1; }
+		"""
+		And a project configuration
+		"""
+		local c = require('configure.lang.c')
+		return function(build)
+			local compiler = c.compiler.find{build = build}
+			local libtest = compiler:link_static_library{
+				name = 'test',
+				sources = {'my.c'},
+			}
+			local exe = compiler:link_executable{
+				name = 'test',
+				sources = {'test.c'},
+				libraries = {libtest,},
+			}
+		end
+		"""
+		When I configure with build RESPONSE_FILE_THRESHOLD=1
+		And I build everything
+		Then I can launch bin/test
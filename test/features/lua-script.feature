@@ -21,3 +21,14 @@ Feature: Launch lua scripts
 		"""
 		When I configure with -E lua-function test.lua test pif paf
 		Then the stripped command output is "TEST pif paf nil"
+
+	Scenario: With many argument sets
+		Given a temporary directory
+		And a source file test.lua
+		"""
+		function test(arg1, arg2)
+			io.write(arg1 .. arg2 .. ";")
+		end
+		"""
+		When I configure with -E lua-function test.lua test pif paf --next pouf pof
+		Then the stripped command output is "pifpaf;poufpof;"
@@ -4,6 +4,10 @@ import os
 def impl(ctx, path):
     assert os.path.isdir(path)
 
+@then('{path} is a file')
+def impl(ctx, path):
+    assert os.path.isfile(path)
+
 @then('{path} does not exist')
 def impl(ctx, path):
     assert not os.path.exists(path)
@@ -65,6 +65,12 @@ def step_impl(ctx):
     assert ctx.configured
     ctx.built = ctx.cmd(ctx.configure_exe, 'build', '--build') == 0
 
+@when('I clean the build')
+def step_impl(ctx):
+    assert ctx.built
+    ctx.built = False
+    assert ctx.cmd(ctx.configure_exe, 'build', '--build', '--target', 'clean') == 0
+
 @then('I can launch {exe}')
 def step_impl(ctx, exe):
     assert ctx.built
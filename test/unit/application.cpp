@@ -33,3 +33,13 @@ BOOST_AUTO_TEST_CASE(no_build_dir)
 	BOOST_CHECK_EQUAL(app.build_directories().size(), 0u);
 	BOOST_CHECK_EQUAL(app.project_directory(), env.dir());
 }
+
+BOOST_AUTO_TEST_CASE(jobs)
+{
+	TemporaryDirectory env;
+	env.create_file("configure.lua", "-- nothing\n");
+	app_t app({"pif", "-j", "2", "build-a", "build-b"});
+	BOOST_CHECK_EQUAL(app.build_directories().size(), 2u);
+	BOOST_CHECK_THROW(app_t({"pif", "-j", "many", "build"}), std::exception);
+	BOOST_CHECK_THROW(app_t({"pif", "build", "--jobs"}), std::exception);
+}
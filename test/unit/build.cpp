@@ -1,8 +1,16 @@
 #include "tools/TemporaryProject.hpp"
 
+#include <configure/BuildGraph.hpp>
+#include <configure/Command.hpp>
+#include <configure/DependencyLink.hpp>
+#include <configure/Graph.hpp>
+#include <configure/Manifest.hpp>
+
 #include <boost/optional.hpp>
 #include <boost/optional/optional_io.hpp>
 
+#include <cstdlib>
+
 using namespace configure;
 
 namespace {
@@ -73,6 +81,23 @@ BOOST_AUTO_TEST_CASE(inexistent_source_node)
 	BOOST_CHECK_THROW(project.configure(), error::LuaError);
 }
 
+BOOST_AUTO_TEST_CASE(node_identity)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  local a = build:virtual_node('a')\n"
+	    "  assert(rawequal(a, build:virtual_node('a')))\n"
+	    "  assert(not rawequal(a, build:virtual_node('b')))\n"
+	    "  local set = {[a] = true}\n"
+	    "  assert(set[build:virtual_node('a')])\n"
+	    "  a = nil; set = nil\n"
+	    "  collectgarbage()\n"
+	    "  assert(build:virtual_node('a'):name() == 'a')\n"
+	    "end"
+	);
+	BOOST_CHECK_NO_THROW(project.configure());
+}
+
 BOOST_AUTO_TEST_CASE(empty_option)
 {
 	TemporaryDirectory temp;
@@ -111,3 +136,221 @@ BOOST_AUTO_TEST_CASE(option_read_environ)
 	);
 
 }
+
+BOOST_AUTO_TEST_CASE(save_load_graph)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  local src = build:source_node(Path:new('test.c'))\n"
+	    "  local obj = build:target_node(Path:new('test.o'))\n"
+	    "  local cmd = ShellCommand:new('cc', '-c', src, '-o', obj)\n"
+	    "  cmd:working_directory(build:directory())\n"
+	    "  build:add_rule(Rule:new():add_source(src):add_target(obj):add_shell_command(cmd))\n"
+	    "  build:add_rule(Rule:new():add_source(obj):add_target(build:virtual_node('all')))\n"
+	    "  build:string_option('SOME_OPTION', 'Some description', 'value')\n"
+	    "end"
+	);
+	project.directory.create_file("test.c");
+	project.configure();
+	auto snapshot = project.directory.dir() / "graph";
+	project.build.save_graph(snapshot);
+
+	lua::State state;
+	Build build(CONFIGURE_PATH, state, project.directory.dir() / "build");
+	build.load_graph(snapshot);
+	auto& g = build.build_graph();
+	BOOST_CHECK_EQUAL(boost::num_vertices(g.graph()),
+	                  boost::num_vertices(project.build.build_graph().graph()));
+	BOOST_CHECK_EQUAL(boost::num_edges(g.graph()), 2);
+	BOOST_CHECK_EQUAL(build.configured_projects().at(0), project.directory.dir());
+	BOOST_CHECK_EQUAL(build.options().count("SOME_OPTION"), 1);
+
+	auto& src = build.file_node(project.directory.dir() / "test.c");
+	auto& obj = build.target_node("test.o");
+	BOOST_REQUIRE(g.has_link(*src, *obj));
+	auto& cmd = g.link(boost::edge(src->index, obj->index, g.graph()).first).command();
+	BOOST_REQUIRE_EQUAL(cmd.shell_commands().size(), 1);
+	auto& shell_command = cmd.shell_commands()[0];
+	BOOST_CHECK(shell_command.has_working_directory());
+	BOOST_CHECK_EQUAL(shell_command.args().size(), 5);
+	BOOST_CHECK(boost::get<NodePtr>(shell_command.args()[2]) == src);
+	BOOST_CHECK(boost::get<NodePtr>(shell_command.args()[4]) == obj);
+	BOOST_CHECK(g.has_link(*obj, *build.virtual_node("all")));
+
+	// Only an empty build can be restored.
+	BOOST_CHECK_THROW(build.load_graph(snapshot), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(independent_projects)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  for _, name in ipairs({'a', 'b', 'c'}) do\n"
+	    "    build:include{directory = name, build_directory = name, independent = true}\n"
+	    "  end\n"
+	    "end"
+	);
+	for (auto name: {"a", "b", "c"})
+	{
+		fs::create_directories(project.directory.dir() / name);
+		project.directory.create_file(
+		    fs::path(name) / "configure.lua",
+		    "return function(build)\n"
+		    "  local target = build:target_node(Path:new('out.txt'))\n"
+		    "  build:add_rule(\n"
+		    "    Rule:new():add_target(target):add_shell_command(ShellCommand:new('touch', target))\n"
+		    "  )\n"
+		    "  build:string_option('OPTION_" + std::string(name) + "', 'Some option', 'value')\n"
+		    "end"
+		);
+	}
+	project.configure();
+	auto& build = project.build;
+	// Projects are merged in declaration order.
+	BOOST_REQUIRE_EQUAL(build.configured_projects().size(), 4);
+	BOOST_CHECK_EQUAL(build.configured_projects()[1], project.directory.dir() / "a");
+	BOOST_CHECK_EQUAL(build.configured_projects()[2], project.directory.dir() / "b");
+	BOOST_CHECK_EQUAL(build.configured_projects()[3], project.directory.dir() / "c");
+	for (auto name: {"a", "b", "c"})
+	{
+		auto& target = build.target_node(fs::path(name) / "out.txt");
+		BOOST_CHECK(build.build_graph().has_link(*build.root_node(), *target));
+		BOOST_CHECK_EQUAL(build.options().count(Environ::normalize("OPTION_" + std::string(name))), 1);
+		BOOST_CHECK_EQUAL(build.env().get<std::string>("OPTION_" + std::string(name)), "value");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(independent_projects_job_limit)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  for _, name in ipairs({'a', 'b', 'c', 'd'}) do\n"
+	    "    build:include{directory = name, build_directory = name, independent = true}\n"
+	    "  end\n"
+	    "end"
+	);
+	auto marker = (project.directory.dir() / "running").generic_string();
+	for (auto name: {"a", "b", "c", "d"})
+	{
+		fs::create_directories(project.directory.dir() / name);
+		project.directory.create_file(
+		    fs::path(name) / "configure.lua",
+		    "return function(build)\n"
+		    "  local f = io.open('" + marker + "', 'r')\n"
+		    "  if f ~= nil then f:close(); error('Configured concurrently') end\n"
+		    "  f = io.open('" + marker + "', 'w'); f:close()\n"
+		    "  local stop = os.clock() + 0.2\n"
+		    "  while os.clock() < stop do end\n"
+		    "  os.remove('" + marker + "')\n"
+		    "end"
+		);
+	}
+	project.build.jobs(1);
+	project.configure();
+	BOOST_CHECK_EQUAL(project.build.configured_projects().size(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(independent_projects_have_no_args)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  build:include{directory = 'a', args = {}, independent = true}\n"
+	    "end"
+	);
+	fs::create_directories(project.directory.dir() / "a");
+	project.directory.create_file("a/configure.lua", "return function(build) end");
+	BOOST_CHECK_THROW(project.configure(), error::LuaError);
+}
+
+BOOST_AUTO_TEST_CASE(independent_projects_properties)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  build:target_node(Path:new('shared')):set_property('ROOT', 'root')\n"
+	    "  for _, name in ipairs({'a', 'b', 'c', 'd'}) do\n"
+	    "    build:include{directory = name, independent = true}\n"
+	    "  end\n"
+	    "end"
+	);
+	for (auto name: {"a", "b", "c", "d"})
+	{
+		fs::create_directories(project.directory.dir() / name);
+		project.directory.create_file(
+		    fs::path(name) / "configure.lua",
+		    "return function(build)\n"
+		    "  local node = build:target_node(Path:new('shared'))\n"
+		    "  assert(node:property('ROOT') == 'root')\n"
+		    "  node:set_property('" + std::string(name) + "', 'value')\n"
+		    "  node:set_property('LAST', '" + std::string(name) + "')\n"
+		    "end"
+		);
+	}
+	project.configure();
+	auto& build = project.build;
+	auto& properties = build.build_graph().properties(
+	    *build.target_node(fs::path("shared")));
+	BOOST_CHECK_EQUAL(properties.get<std::string>("ROOT"), "root");
+	for (auto name: {"a", "b", "c", "d"})
+		BOOST_CHECK_EQUAL(properties.get<std::string>(name), "value");
+	// Sub-projects are merged in declaration order.
+	BOOST_CHECK_EQUAL(properties.get<std::string>("LAST"), "d");
+}
+
+BOOST_AUTO_TEST_CASE(glob_directories_are_inputs)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  build:fs():glob('src/*.c')\n"
+	    "end"
+	);
+	fs::create_directories(project.directory.dir() / "src");
+	project.directory.create_file("src/a.c");
+	project.configure();
+	auto& manifest = project.build.manifest();
+	manifest.add_output(project.directory.dir() / "src" / "a.c");
+	BOOST_CHECK(!manifest.find_change(manifest.project_directory(), {}));
+	project.directory.create_file("src/b.c");
+	BOOST_CHECK(manifest.find_change(manifest.project_directory(), {}));
+}
+
+BOOST_AUTO_TEST_CASE(environment_variables_are_inputs)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  assert(os.getenv('CONFIGURE_TEST_VARIABLE') == nil)\n"
+	    "end"
+	);
+	project.configure();
+	auto& manifest = project.build.manifest();
+	BOOST_CHECK(!manifest.find_change(manifest.project_directory(), {}));
+#ifdef _WIN32
+	::_putenv_s("CONFIGURE_TEST_VARIABLE", "value");
+#else
+	::setenv("CONFIGURE_TEST_VARIABLE", "value", 1);
+#endif
+	BOOST_CHECK(manifest.find_change(manifest.project_directory(), {}));
+#ifdef _WIN32
+	::_putenv_s("CONFIGURE_TEST_VARIABLE", "");
+#else
+	::unsetenv("CONFIGURE_TEST_VARIABLE");
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(lua_writes_invalidate_stat_cache)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  local p = build:directory() / 'file'\n"
+	    "  assert(not p:exists())\n"
+	    "  local f = assert(io.open(tostring(p), 'w'))\n"
+	    "  f:close()\n"
+	    "  assert(p:exists())\n"
+	    "  local q = build:directory() / 'other'\n"
+	    "  assert(os.rename(tostring(p), tostring(q)))\n"
+	    "  assert(not p:exists() and q:exists())\n"
+	    "  assert(os.remove(tostring(q)))\n"
+	    "  assert(not q:exists())\n"
+	    "end"
+	);
+	project.configure();
+}
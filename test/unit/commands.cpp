@@ -0,0 +1,381 @@
+#include "tools/TemporaryDirectory.hpp"
+
+#include <configure/commands.hpp>
+#include <configure/commands/copy.hpp>
+#include <configure/commands/extract.hpp>
+#include <configure/commands/fetch.hpp>
+#include <configure/commands/lua_function.hpp>
+#include <configure/commands/remove.hpp>
+#include <configure/commands/touch.hpp>
+
+#include <boost/crc.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+
+namespace commands = configure::commands;
+
+static std::string read(fs::path const& p)
+{
+	std::ifstream in(p.string(), std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in),
+	                   std::istreambuf_iterator<char>());
+}
+
+BOOST_AUTO_TEST_CASE(copy)
+{
+	TemporaryDirectory temp;
+	temp.create_file("a", "content a");
+	temp.create_file("b", "content b");
+	auto a = temp.dir() / "a", b = temp.dir() / "b";
+	auto a2 = temp.dir() / "sub" / "a", b2 = temp.dir() / "b2";
+	commands::copy({{a, a2}, {b, b2}});
+	BOOST_CHECK_EQUAL(read(a2), "content a");
+	BOOST_CHECK_EQUAL(read(b2), "content b");
+
+	// Same content: only touched.
+	fs::last_write_time(a2, 1000);
+	commands::copy({{a, a2}});
+	BOOST_CHECK_GT(fs::last_write_time(a2), 1000);
+	BOOST_CHECK(!fs::equivalent(a, a2));
+
+	// Same content with a stamp: left alone, the stamp is touched.
+	fs::last_write_time(a2, 1000);
+	commands::copy({{a, a2}}, false, temp.dir() / "stamps" / "copy");
+	BOOST_CHECK_EQUAL(fs::last_write_time(a2), 1000);
+	BOOST_CHECK(fs::is_regular_file(temp.dir() / "stamps" / "copy"));
+
+	// Different content: replaced.
+	temp.create_file("b2", "old");
+	commands::copy({{b, b2}});
+	BOOST_CHECK_EQUAL(read(b2), "content b");
+}
+
+BOOST_AUTO_TEST_CASE(copy_hardlink)
+{
+	TemporaryDirectory temp;
+	temp.create_file("a", "content a");
+	auto a = temp.dir() / "a", a2 = temp.dir() / "a2";
+	commands::copy({{a, a2}}, true);
+	BOOST_CHECK_EQUAL(read(a2), "content a");
+	BOOST_CHECK(fs::equivalent(a, a2));
+	// Already linked, nothing to do.
+	commands::copy({{a, a2}}, true);
+	BOOST_CHECK(fs::equivalent(a, a2));
+}
+
+namespace {
+
+	std::string tar_member(std::string const& name,
+	                       std::string const& content,
+	                       char type = '0',
+	                       std::string const& link = "")
+	{
+		char header[512];
+		std::memset(header, 0, sizeof(header));
+		std::strncpy(header, name.c_str(), 100);
+		std::sprintf(header + 100, "%07o", 0644);
+		std::sprintf(header + 124, "%011o", (unsigned) content.size());
+		std::sprintf(header + 136, "%011o", 1000000000u);
+		header[156] = type;
+		std::strncpy(header + 157, link.c_str(), 100);
+		std::memcpy(header + 257, "ustar", 6);
+		std::memset(header + 148, ' ', 8);
+		unsigned sum = 0;
+		for (unsigned char c: header)
+			sum += c;
+		std::sprintf(header + 148, "%06o", sum);
+		std::string res(header, sizeof(header));
+		res += content;
+		res.append((512 - content.size() % 512) % 512, '\0');
+		return res;
+	}
+
+	void write_le(std::string& out, uint32_t value, int bytes)
+	{
+		for (int i = 0; i < bytes; ++i)
+			out += static_cast<char>((value >> (8 * i)) & 0xff);
+	}
+
+	// Zip archive with stored (uncompressed) members. The content of
+	// `symlinks` members is their target.
+	std::string zip_archive(std::vector<std::pair<std::string, std::string>> const& files,
+	                        std::set<std::string> const& symlinks = {})
+	{
+		std::string res, directory;
+		for (auto& file: files)
+		{
+			boost::crc_32_type crc;
+			crc.process_bytes(file.second.data(), file.second.size());
+			std::string common;
+			write_le(common, 0, 2); // flags
+			write_le(common, 0, 2); // method
+			write_le(common, 0, 4); // time and date
+			write_le(common, crc.checksum(), 4);
+			write_le(common, file.second.size(), 4);
+			write_le(common, file.second.size(), 4);
+			write_le(common, file.first.size(), 2);
+			write_le(common, 0, 2); // extra
+			uint32_t offset = res.size();
+			write_le(res, 0x04034b50, 4);
+			write_le(res, 20, 2);
+			res += common + file.first + file.second;
+			write_le(directory, 0x02014b50, 4);
+			write_le(directory, (3 << 8) | 20, 2);
+			write_le(directory, 20, 2);
+			directory += common;
+			write_le(directory, 0, 2); // comment
+			write_le(directory, 0, 2); // disk
+			write_le(directory, 0, 2); // internal attributes
+			write_le(directory, (symlinks.count(file.first) ? 0120777u : 0100755u) << 16, 4);
+			write_le(directory, offset, 4);
+			directory += file.first;
+		}
+		uint32_t directory_offset = res.size();
+		res += directory;
+		write_le(res, 0x06054b50, 4);
+		write_le(res, 0, 4);
+		write_le(res, files.size(), 2);
+		write_le(res, files.size(), 2);
+		write_le(res, directory.size(), 4);
+		write_le(res, directory_offset, 4);
+		write_le(res, 0, 2);
+		return res;
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(extract_tarball)
+{
+	TemporaryDirectory temp;
+	{
+		namespace io = boost::iostreams;
+		std::ofstream file((temp.dir() / "archive.tar.gz").string(), std::ios::binary);
+		io::filtering_ostream out;
+		out.push(io::gzip_compressor());
+		out.push(file);
+		out << tar_member("project-1.0/", "", '5')
+		    << tar_member("project-1.0/README", "readme")
+		    << tar_member("project-1.0/src/main.c", std::string(2000, 'x'))
+		    << tar_member("project-1.0/LINK", "", '2', "README")
+		    << std::string(1024, '\0');
+	}
+	auto dest = temp.dir() / "dest";
+	commands::extract(temp.dir() / "archive.tar.gz", dest);
+	BOOST_CHECK_EQUAL(read(dest / "README"), "readme");
+	BOOST_CHECK_EQUAL(read(dest / "src/main.c"), std::string(2000, 'x'));
+	BOOST_CHECK_EQUAL(fs::last_write_time(dest / "README"), 1000000000);
+	BOOST_CHECK_EQUAL(read(dest / "LINK"), "readme");
+
+	commands::extract(temp.dir() / "archive.tar.gz", temp.dir() / "full", 0u);
+	BOOST_CHECK_EQUAL(read(temp.dir() / "full/project-1.0/README"), "readme");
+
+	temp.create_file("evil.tar", tar_member("../evil", "evil") + std::string(1024, '\0'));
+	BOOST_CHECK_THROW(commands::extract(temp.dir() / "evil.tar", dest, 0u),
+	                  std::exception);
+	BOOST_CHECK(!fs::exists(temp.dir() / "evil"));
+}
+
+BOOST_AUTO_TEST_CASE(extract_tarball_symlinks)
+{
+	TemporaryDirectory temp;
+	auto outside = temp.dir() / "outside";
+	fs::create_directories(outside);
+	auto dest = temp.dir() / "dest";
+
+	// Written before the link is created.
+	temp.create_file(
+		"evil.tar",
+		tar_member("a", "", '2', outside.string()) +
+		tar_member("a/x", "evil") +
+		std::string(1024, '\0')
+	);
+	BOOST_CHECK_THROW(commands::extract(temp.dir() / "evil.tar", dest, 0u),
+	                  std::exception);
+	BOOST_CHECK(!fs::exists(outside / "x"));
+	BOOST_CHECK(!fs::is_symlink(dest / "a"));
+
+	for (auto target: {"../../outside", "../b/../../outside", "../b/.."})
+	{
+		temp.create_file(
+			"evil.tar",
+			tar_member("b", "", '2', ".") +
+			tar_member("sub/link", "", '2', target) +
+			std::string(1024, '\0')
+		);
+		BOOST_CHECK_THROW(commands::extract(temp.dir() / "evil.tar", dest, 0u),
+		                  std::exception);
+		BOOST_CHECK(!fs::exists(dest / "sub/link"));
+	}
+
+	temp.create_file(
+		"good.tar",
+		tar_member("lib/libfoo.so.1", "foo") +
+		tar_member("lib/libfoo.so", "", '2', "libfoo.so.1") +
+		tar_member("bin/libfoo.so", "", '2', "../lib/libfoo.so") +
+		std::string(1024, '\0')
+	);
+	commands::extract(temp.dir() / "good.tar", dest, 0u);
+	BOOST_CHECK_EQUAL(read(dest / "bin/libfoo.so"), "foo");
+}
+
+BOOST_AUTO_TEST_CASE(extract_zip)
+{
+	TemporaryDirectory temp;
+	std::vector<std::pair<std::string, std::string>> files;
+	for (int i = 0; i < 20; ++i)
+		files.emplace_back("dir/file" + std::to_string(i), std::string(i * 100, 'a' + i));
+	temp.create_file("archive.zip", zip_archive(files));
+	auto dest = temp.dir() / "dest";
+	commands::extract(temp.dir() / "archive.zip", dest);
+	for (auto& file: files)
+		BOOST_CHECK_EQUAL(read(dest / file.first), file.second);
+	commands::extract(temp.dir() / "archive.zip", temp.dir() / "stripped", 1u);
+	BOOST_CHECK_EQUAL(read(temp.dir() / "stripped/file3"), files[3].second);
+}
+
+BOOST_AUTO_TEST_CASE(extract_zip_symlinks)
+{
+	TemporaryDirectory temp;
+	auto outside = temp.dir() / "outside";
+	fs::create_directories(outside);
+	auto dest = temp.dir() / "dest";
+
+	temp.create_file(
+		"evil.zip",
+		zip_archive({{"a", outside.string()}, {"a/x", "evil"}}, {"a"})
+	);
+	BOOST_CHECK_THROW(commands::extract(temp.dir() / "evil.zip", dest),
+	                  std::exception);
+	BOOST_CHECK(!fs::exists(outside / "x"));
+
+	temp.create_file(
+		"evil.zip",
+		zip_archive({{"dir/link", "../../outside"}}, {"dir/link"})
+	);
+	BOOST_CHECK_THROW(commands::extract(temp.dir() / "evil.zip", dest),
+	                  std::exception);
+	BOOST_CHECK(!fs::exists(dest / "dir/link"));
+
+	temp.create_file(
+		"good.zip",
+		zip_archive({{"dir/file", "content"}, {"dir/link", "file"}}, {"dir/link"})
+	);
+	commands::extract(temp.dir() / "good.zip", dest);
+	BOOST_CHECK(fs::is_symlink(dest / "dir/link"));
+	BOOST_CHECK_EQUAL(read(dest / "dir/link"), "content");
+}
+
+BOOST_AUTO_TEST_CASE(fetch)
+{
+	TemporaryDirectory temp;
+	temp.create_file("file", "abc");
+	auto uri = "file://" + (temp.dir() / "file").string();
+	std::string checksum =
+		"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+	commands::fetch(uri, temp.dir() / "plain");
+	BOOST_CHECK_EQUAL(read(temp.dir() / "plain"), "abc");
+
+	BOOST_CHECK_THROW(
+		commands::fetch(uri, temp.dir() / "bad", std::string(64, '0')),
+		std::exception
+	);
+	BOOST_CHECK(!fs::exists(temp.dir() / "bad"));
+
+	auto cache = temp.dir() / "cache";
+	commands::fetch(uri, temp.dir() / "a", checksum, cache);
+	auto cached = cache / "sha256" / "ba" / checksum;
+	BOOST_CHECK_EQUAL(read(cached), "abc");
+	BOOST_CHECK(fs::equivalent(cached, temp.dir() / "a"));
+
+	// The cache is used even when the source is gone.
+	fs::remove(temp.dir() / "file");
+	commands::fetch(uri, temp.dir() / "b", checksum, cache);
+	BOOST_CHECK_EQUAL(read(temp.dir() / "b"), "abc");
+}
+
+BOOST_AUTO_TEST_CASE(touch)
+{
+	TemporaryDirectory temp;
+	auto file = temp.dir() / "file";
+	commands::touch(file);
+	BOOST_CHECK(fs::is_regular_file(file));
+	fs::last_write_time(file, 1000);
+	commands::touch(file);
+	BOOST_CHECK_GT(fs::last_write_time(file), 1000);
+
+	commands::touch_stamp(file, "1234");
+	BOOST_CHECK_EQUAL(read(file), "1234\n");
+}
+
+BOOST_AUTO_TEST_CASE(remove_paths)
+{
+	TemporaryDirectory temp;
+	auto dir = temp.dir() / "dir";
+	fs::create_directories(dir / "sub");
+	commands::touch(dir / "sub" / "file");
+	commands::touch(temp.dir() / "file");
+	commands::remove({dir, temp.dir() / "file", temp.dir() / "missing"});
+	BOOST_CHECK(!fs::exists(dir));
+	BOOST_CHECK(!fs::exists(temp.dir() / "file"));
+}
+
+BOOST_AUTO_TEST_CASE(batch)
+{
+	TemporaryDirectory temp;
+	auto a = (temp.dir() / "a").string(), b = (temp.dir() / "b").string();
+	commands::execute({"batch", "touch", a, "--then", "copy", a, b});
+	BOOST_CHECK(fs::is_regular_file(b));
+
+	// Stops at the first failure.
+	auto c = (temp.dir() / "c").string();
+	BOOST_CHECK_THROW(
+		commands::execute({"batch", "copy", c, b, "--then", "touch", c}),
+		std::exception
+	);
+	BOOST_CHECK(!fs::exists(c));
+
+	temp.create_file("batch", "touch\n" + c + "\n\ncopy\n" + c + "\n" + a + "\n");
+	commands::execute({"batch", "--file", (temp.dir() / "batch").string()});
+	BOOST_CHECK(fs::is_regular_file(c));
+}
+
+BOOST_AUTO_TEST_CASE(lua_function)
+{
+	TemporaryDirectory temp;
+	temp.create_file(
+		"script.lua",
+		"function test(path, content)\n"
+		"  local f = io.open(path, 'a'); f:write(content); f:close()\n"
+		"end\n"
+	);
+	auto out = (temp.dir() / "out").string();
+	auto cache = temp.dir() / "cache";
+	for (int i = 0; i < 2; ++i) // Compiled, then from the cache
+		commands::lua_function(
+			temp.dir() / "script.lua",
+			"test",
+			{{out, "a"}, {out, "b"}},
+			cache
+		);
+	BOOST_CHECK_EQUAL(read(out), "abab");
+	BOOST_CHECK_EQUAL(
+		std::distance(fs::directory_iterator(cache), fs::directory_iterator()),
+		1
+	);
+
+	// Same size and mtime, different content: not served from the cache.
+	auto script = temp.dir() / "script.lua";
+	auto mtime = fs::last_write_time(script);
+	auto source = read(script);
+	source.replace(source.find("'a'"), 3, "'w'");
+	temp.create_file("script.lua", source);
+	fs::last_write_time(script, mtime);
+	commands::lua_function(script, "test", {{out, "c"}}, cache);
+	BOOST_CHECK_EQUAL(read(out), "c");
+}
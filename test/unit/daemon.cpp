@@ -0,0 +1,54 @@
+#include "tools/TemporaryDirectory.hpp"
+
+#include <configure/Daemon.hpp>
+#include <configure/Manifest.hpp>
+
+#include <boost/optional/optional_io.hpp>
+
+#include <atomic>
+#include <thread>
+
+using configure::Daemon;
+using configure::Manifest;
+
+#ifdef __linux__
+BOOST_AUTO_TEST_CASE(requests)
+{
+	TemporaryDirectory temp;
+	auto const project = temp.dir().string();
+	BOOST_CHECK_EQUAL(Daemon::request(temp.dir(), "configure", {project}),
+	                  boost::none);
+
+	std::atomic<int> count(0);
+	Daemon daemon(temp.dir(), [&] {
+		if (++count == 3)
+			throw std::runtime_error("Nope");
+		Manifest manifest;
+		manifest.project_directory(temp.dir());
+		manifest.add_variable("CONFIGURE_TEST_VARIABLE", boost::none);
+		manifest.save(temp.dir() / ".build" / "manifest");
+		return std::string("configured");
+	});
+	BOOST_CHECK_THROW(Daemon(temp.dir(), [] { return std::string(); }),
+	                  std::exception);
+	std::thread thread([&] { daemon.run(); });
+	BOOST_CHECK_EQUAL(Daemon::request(temp.dir(), "configure", {project}),
+	                  std::string("configured"));
+
+	// Refused when the client does not share the inputs of the daemon.
+	BOOST_CHECK_EQUAL(Daemon::request(temp.dir(), "configure", {"/other"}),
+	                  boost::none);
+	BOOST_CHECK_EQUAL(
+	    Daemon::request(temp.dir(), "configure",
+	                    {project, "CONFIGURE_TEST_VARIABLE=value"}),
+	    boost::none);
+	BOOST_CHECK_EQUAL(count, 2);
+
+	BOOST_CHECK_THROW(Daemon::request(temp.dir(), "configure", {project}),
+	                  std::exception);
+	BOOST_CHECK_EQUAL(Daemon::request(temp.dir(), "stop"),
+	                  std::string("stopped"));
+	thread.join();
+	BOOST_CHECK_EQUAL(count, 3);
+}
+#endif
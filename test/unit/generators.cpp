@@ -0,0 +1,133 @@
+#include "tools/TemporaryProject.hpp"
+
+#include <configure/generators/Makefile.hpp>
+#include <configure/Process.hpp>
+
+#include <fstream>
+#include <iterator>
+
+using namespace configure;
+
+namespace {
+
+	std::string read_file(fs::path const& p)
+	{
+		std::ifstream in(p.string());
+		return std::string(std::istreambuf_iterator<char>(in),
+		                   std::istreambuf_iterator<char>());
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(makefile_multiple_targets)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  local a = build:target_node(Path:new('a.txt'))\n"
+	    "  local b = build:target_node(Path:new('b.txt'))\n"
+	    "  build:add_rule(\n"
+	    "    Rule:new():add_target(a):add_target(b)\n"
+	    "      :add_shell_command(ShellCommand:new('generate-both', a, b))\n"
+	    "  )\n"
+	    "end"
+	);
+	project.configure();
+	generators::Makefile makefile(
+	    project.build,
+	    project.directory.dir(),
+	    "/path/to/configure"
+	);
+	Generator& generator = makefile;
+	generator.prepare();
+	generator.generate();
+	auto content = read_file(project.build.directory() / "Makefile");
+	BOOST_TEST_MESSAGE(content);
+
+	// The commands are run once, by the first target.
+	auto first = content.find("\tgenerate-both");
+	BOOST_REQUIRE(first != std::string::npos);
+	BOOST_CHECK_EQUAL(content.find("\tgenerate-both", first + 1), std::string::npos);
+	BOOST_CHECK(content.find("\na.txt:") != std::string::npos);
+
+	// The other target is listed and depends on the first one, which is out
+	// of date when it is missing.
+	BOOST_CHECK(content.find(
+		"\nb.txt: a.txt\n"
+		"a.txt: $(if $(wildcard b.txt),,FORCE)\n"
+	) != std::string::npos);
+	BOOST_CHECK(content.find("\nFORCE:\n") != std::string::npos);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(makefile_missing_secondary_target)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  local a = build:target_node(Path:new('a.txt'))\n"
+	    "  local b = build:target_node(Path:new('b.txt'))\n"
+	    "  local c = build:target_node(Path:new('c.txt'))\n"
+	    "  build:add_rule(\n"
+	    "    Rule:new():add_target(a):add_target(b)\n"
+	    "      :add_shell_command(ShellCommand:new('touch', a, b))\n"
+	    "  )\n"
+	    "  build:add_rule(\n"
+	    "    Rule:new():add_source(a):add_target(c)\n"
+	    "      :add_shell_command(ShellCommand:new('touch', c))\n"
+	    "  )\n"
+	    "end"
+	);
+	project.configure();
+	if (!generators::Makefile::is_available(project.build))
+		return;
+	generators::Makefile makefile(
+	    project.build,
+	    project.directory.dir(),
+	    "/path/to/configure"
+	);
+	Generator& generator = makefile;
+	generator.prepare();
+	generator.generate();
+	auto dir = project.build.directory().string();
+	Process::check_call({"make", "-s", "-C", dir});
+
+	// A single run remakes the missing target and what depends on the
+	// other targets of its rule.
+	fs::remove(project.build.directory() / "b.txt");
+	Process::check_call({"make", "-s", "-C", dir});
+	BOOST_CHECK(fs::exists(project.build.directory() / "b.txt"));
+	BOOST_CHECK_EQUAL(Process::call({"make", "-q", "-C", dir}), 0);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(makefile_copy_files)
+{
+	TemporaryProject project(
+	    "return function(build)\n"
+	    "  build:fs():copy_files({\n"
+	    "    {build:project_directory() / 'a.txt', 'share/a.txt'},\n"
+	    "    {build:project_directory() / 'b.txt', 'share/b.txt'},\n"
+	    "  })\n"
+	    "end"
+	);
+	project.directory.create_file("a.txt");
+	project.directory.create_file("b.txt");
+	project.configure();
+	generators::Makefile makefile(
+	    project.build,
+	    project.directory.dir(),
+	    "/path/to/configure"
+	);
+	Generator& generator = makefile;
+	generator.prepare();
+	generator.generate();
+	auto content = read_file(project.build.directory() / "Makefile");
+	BOOST_TEST_MESSAGE(content);
+
+	// The copy is run by the stamp, the copied files are not touched.
+	auto pos = content.find("\n.build/stamps/copy-");
+	BOOST_REQUIRE(pos != std::string::npos);
+	auto stamp = content.substr(pos + 1, content.find(':', pos) - pos - 1);
+	BOOST_CHECK(content.find("-E copy --stamp " + stamp) != std::string::npos);
+	BOOST_CHECK(content.find("\nshare/a.txt: " + stamp + "\n") != std::string::npos);
+	BOOST_CHECK(content.find("\nshare/b.txt: " + stamp + "\n") != std::string::npos);
+}
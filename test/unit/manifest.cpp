@@ -0,0 +1,209 @@
+#include "tools/TemporaryDirectory.hpp"
+
+#include <configure/Filesystem.hpp>
+#include <configure/Manifest.hpp>
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/optional/optional_io.hpp>
+
+#include <cstdlib>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/stat.h>
+#endif
+
+using namespace configure;
+
+typedef std::map<std::string, std::string> Args;
+
+namespace {
+
+	void set_variable(char const* name, char const* value)
+	{
+#ifdef _WIN32
+		::_putenv_s(name, value == nullptr ? "" : value);
+#else
+		if (value == nullptr)
+			::unsetenv(name);
+		else
+			::setenv(name, value, 1);
+#endif
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(empty)
+{
+	TemporaryDirectory temp;
+	Manifest m;
+	BOOST_CHECK(m.find_change(temp.dir(), Args()));
+	// Nothing was ever generated.
+	BOOST_CHECK(!m.is_up_to_date());
+}
+
+BOOST_AUTO_TEST_CASE(up_to_date)
+{
+	TemporaryDirectory temp;
+	temp.create_file("configure.lua", "return function() end");
+	temp.create_file("Makefile");
+	fs::create_directories(temp.dir() / "src");
+	Manifest m;
+	m.project_directory(temp.dir());
+	m.arguments(Args{{"CC", "gcc"}});
+	m.add_file(temp.dir() / "configure.lua");
+	m.add_directory(temp.dir() / "src");
+	m.add_path(temp.dir() / "NOT_HERE");
+	m.add_output(temp.dir() / "Makefile");
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args{{"CC", "gcc"}}), boost::none);
+	BOOST_CHECK(m.find_change(temp.dir(), Args{{"CC", "clang"}}));
+	BOOST_CHECK(m.find_change(temp.dir(), Args{{"CXX", "g++"}}));
+	BOOST_CHECK(m.find_change(temp.dir() / "src", Args()));
+}
+
+BOOST_AUTO_TEST_CASE(save_load)
+{
+	TemporaryDirectory temp;
+	temp.create_file("configure.lua", "return function() end");
+	temp.create_file("Makefile");
+	{
+		Manifest m;
+		m.project_directory(temp.dir());
+		m.add_file(temp.dir() / "configure.lua");
+		m.add_output(temp.dir() / "Makefile");
+		m.save(temp.dir() / "manifest");
+	}
+	Manifest m;
+	m.load(temp.dir() / "manifest");
+	BOOST_CHECK_EQUAL(m.project_directory(), temp.dir());
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+}
+
+BOOST_AUTO_TEST_CASE(load_other_version)
+{
+	TemporaryDirectory temp;
+	{
+		std::ofstream out((temp.dir() / "manifest").string(), std::ios::binary);
+		boost::archive::binary_oarchive ar(out);
+		unsigned int version = 42;
+		ar << version;
+	}
+	Manifest m;
+	BOOST_CHECK_THROW(m.load(temp.dir() / "manifest"), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(changes)
+{
+	TemporaryDirectory temp;
+	temp.create_file("configure.lua", "return function() end");
+	temp.create_file("Makefile");
+	fs::create_directories(temp.dir() / "src");
+	Manifest m;
+	m.project_directory(temp.dir());
+	m.add_file(temp.dir() / "configure.lua");
+	m.add_directory(temp.dir() / "src");
+	m.add_path(temp.dir() / "NOT_HERE");
+	m.add_output(temp.dir() / "Makefile");
+	BOOST_REQUIRE_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+
+	temp.create_file("NOT_HERE");
+	BOOST_CHECK(m.find_change(temp.dir(), Args()));
+	fs::remove(temp.dir() / "NOT_HERE");
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+
+	temp.create_file("configure.lua", "return function(build) end");
+	BOOST_CHECK(m.find_change(temp.dir(), Args()));
+}
+
+BOOST_AUTO_TEST_CASE(outputs)
+{
+	TemporaryDirectory temp;
+	temp.create_file("Makefile");
+	temp.create_file("build.sh");
+	Manifest m;
+	m.add_output(temp.dir() / "Makefile");
+	BOOST_CHECK(m.is_up_to_date());
+	BOOST_CHECK(m.is_up_to_date(temp.dir() / "Makefile"));
+	BOOST_CHECK(!m.is_up_to_date(temp.dir() / "build.sh"));
+	m.add_output(temp.dir() / "build.sh");
+	BOOST_CHECK(m.is_up_to_date(temp.dir() / "build.sh"));
+	fs::remove(temp.dir() / "Makefile");
+	BOOST_CHECK(!m.is_up_to_date());
+	BOOST_CHECK(!m.is_up_to_date(temp.dir() / "Makefile"));
+	BOOST_CHECK(m.is_up_to_date(temp.dir() / "build.sh"));
+}
+
+BOOST_AUTO_TEST_CASE(programs)
+{
+	TemporaryDirectory temp;
+	temp.create_file("Makefile");
+	Manifest m;
+	m.project_directory(temp.dir());
+	m.add_output(temp.dir() / "Makefile");
+	m.add_program("sh", Filesystem::which("sh"));
+	m.add_program("a-program-that-does-not-exist", boost::none);
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+	m.add_program("sh", boost::none);
+	BOOST_CHECK(m.find_change(temp.dir(), Args()));
+}
+
+BOOST_AUTO_TEST_CASE(variables)
+{
+	TemporaryDirectory temp;
+	set_variable("CONFIGURE_TEST_VARIABLE", "value");
+	set_variable("CONFIGURE_TEST_UNSET_VARIABLE", nullptr);
+	Manifest m;
+	m.project_directory(temp.dir());
+	m.add_variable("CONFIGURE_TEST_VARIABLE", std::string("value"));
+	m.add_variable("CONFIGURE_TEST_UNSET_VARIABLE", boost::none);
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+
+	set_variable("CONFIGURE_TEST_VARIABLE", "other value");
+	BOOST_CHECK(m.find_change(temp.dir(), Args()));
+	set_variable("CONFIGURE_TEST_VARIABLE", "value");
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+
+	set_variable("CONFIGURE_TEST_UNSET_VARIABLE", "value");
+	BOOST_CHECK(m.find_change(temp.dir(), Args()));
+	set_variable("CONFIGURE_TEST_UNSET_VARIABLE", nullptr);
+
+	m.save(temp.dir() / "manifest");
+	Manifest loaded;
+	loaded.load(temp.dir() / "manifest");
+	BOOST_CHECK_EQUAL(loaded.find_change(temp.dir(), Args()), boost::none);
+	set_variable("CONFIGURE_TEST_VARIABLE", nullptr);
+	BOOST_CHECK(loaded.find_change(temp.dir(), Args()));
+}
+
+BOOST_AUTO_TEST_CASE(written_files)
+{
+	TemporaryDirectory temp;
+	temp.create_file("unity.c", "#include \"a.c\"\n");
+	Manifest m;
+	m.project_directory(temp.dir());
+	m.add_written_file(temp.dir() / "unity.c");
+	BOOST_CHECK_EQUAL(m.find_change(temp.dir(), Args()), boost::none);
+	fs::remove(temp.dir() / "unity.c");
+	BOOST_CHECK(m.find_change(temp.dir(), Args()));
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(sub_second_changes)
+{
+	TemporaryDirectory temp;
+	temp.create_file("file", "a");
+	auto path = temp.dir() / "file";
+	struct timespec times[2] = {{1000, 0}, {1000, 0}};
+	BOOST_REQUIRE_EQUAL(::utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+	auto stamp = Manifest::stamp(path);
+	BOOST_CHECK_EQUAL(stamp.mtime, int64_t(1000) * 1000000000);
+	BOOST_CHECK_EQUAL(stamp.size, 1u);
+
+	// Same size, in the same second.
+	temp.create_file("file", "b");
+	times[1].tv_nsec = 500000000;
+	BOOST_REQUIRE_EQUAL(::utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+	BOOST_CHECK(Manifest::stamp(path) != stamp);
+}
+#endif
@@ -0,0 +1,52 @@
+#include "tools/TemporaryDirectory.hpp"
+
+#include <configure/ProbeCache.hpp>
+
+using configure::Environ;
+using configure::ProbeCache;
+
+BOOST_AUTO_TEST_CASE(persistent)
+{
+	TemporaryDirectory temp;
+	int calls = 0;
+	auto compute = [&]() -> Environ::Value { calls += 1; return std::string("value"); };
+	{
+		ProbeCache cache(temp.dir() / "cache");
+		BOOST_CHECK(boost::get<std::string>(cache.get("key", compute)) == "value");
+		BOOST_CHECK(boost::get<std::string>(cache.get("key", compute)) == "value");
+		BOOST_CHECK_EQUAL(calls, 1);
+	}
+	// Shared with other instances (i.e. other build directories).
+	ProbeCache cache(temp.dir() / "cache");
+	cache.get("key", compute);
+	BOOST_CHECK_EQUAL(calls, 1);
+	cache.get("other key", compute);
+	BOOST_CHECK_EQUAL(calls, 2);
+}
+
+BOOST_AUTO_TEST_CASE(values)
+{
+	TemporaryDirectory temp;
+	ProbeCache cache(temp.dir());
+	std::vector<Environ::Value> list{
+		boost::filesystem::path("/usr/include"), true, int64_t(42)
+	};
+	cache.get("list", [&]() -> Environ::Value { return list; });
+	auto res = cache.get("list", []() -> Environ::Value {
+		throw std::runtime_error("Should be cached");
+	});
+	auto& values = boost::get<std::vector<Environ::Value>>(res);
+	BOOST_REQUIRE_EQUAL(values.size(), 3u);
+	BOOST_CHECK(boost::get<boost::filesystem::path>(values[0]) == "/usr/include");
+	BOOST_CHECK(boost::get<bool>(values[1]));
+	BOOST_CHECK_EQUAL(boost::get<int64_t>(values[2]), 42);
+}
+
+BOOST_AUTO_TEST_CASE(disabled)
+{
+	int calls = 0;
+	ProbeCache cache("");
+	cache.get("key", [&]() -> Environ::Value { calls += 1; return true; });
+	cache.get("key", [&]() -> Environ::Value { calls += 1; return true; });
+	BOOST_CHECK_EQUAL(calls, 2);
+}
@@ -24,3 +24,15 @@ BOOST_AUTO_TEST_CASE(empty_output)
 		BOOST_CHECK(out.empty());
 #endif
 }
+
+BOOST_AUTO_TEST_CASE(pipes_not_inherited)
+{
+#ifdef __linux__
+	auto before = Process::check_output({"ls", "/proc/self/fd"});
+	Process::Options options;
+	options.stdout_ = Process::Stream::PIPE;
+	Process other({"true"}, options);
+	BOOST_CHECK_EQUAL(Process::check_output({"ls", "/proc/self/fd"}), before);
+	other.wait();
+#endif
+}
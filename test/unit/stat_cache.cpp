@@ -0,0 +1,73 @@
+#include "tools/TemporaryDirectory.hpp"
+
+#include <configure/StatCache.hpp>
+
+using configure::StatCache;
+
+BOOST_AUTO_TEST_CASE(cached)
+{
+	TemporaryDirectory temp;
+	StatCache cache;
+	auto file = temp.dir() / "file";
+	BOOST_CHECK(!cache.exists(file));
+	BOOST_CHECK_EQUAL(cache.misses(), 1u);
+
+	// Not seen until invalidated.
+	temp.create_file("file");
+	BOOST_CHECK(!cache.exists(file));
+	BOOST_CHECK_EQUAL(cache.hits(), 1u);
+	cache.invalidate(file);
+	BOOST_CHECK(cache.is_regular_file(file));
+	BOOST_CHECK(!cache.is_directory(file));
+	BOOST_CHECK(cache.is_directory(temp.dir()));
+	BOOST_CHECK_EQUAL(cache.last_write_time(file), fs::last_write_time(file));
+	BOOST_CHECK_THROW(cache.last_write_time(temp.dir() / "NOT_HERE"),
+	                  std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(invalidate)
+{
+	TemporaryDirectory temp;
+	StatCache cache;
+	fs::create_directories(temp.dir() / "dir");
+	temp.create_file("dir/a");
+	temp.create_file("dir-b");
+	BOOST_CHECK(cache.exists(temp.dir() / "dir" / "a"));
+	BOOST_CHECK(cache.exists(temp.dir() / "dir-b"));
+	fs::remove(temp.dir() / "dir" / "a");
+	fs::remove(temp.dir() / "dir-b");
+
+	// Only the directory and its content are forgotten.
+	cache.invalidate(temp.dir() / "dir");
+	BOOST_CHECK(!cache.exists(temp.dir() / "dir" / "a"));
+	BOOST_CHECK(cache.exists(temp.dir() / "dir-b"));
+	cache.invalidate();
+	BOOST_CHECK(!cache.exists(temp.dir() / "dir-b"));
+}
+
+BOOST_AUTO_TEST_CASE(invalidate_parent)
+{
+	TemporaryDirectory temp;
+	StatCache cache;
+	fs::create_directories(temp.dir() / "dir" / "sub");
+	BOOST_CHECK(cache.is_directory(temp.dir() / "dir"));
+	BOOST_CHECK(cache.is_directory(temp.dir() / "dir" / "sub"));
+	fs::remove(temp.dir() / "dir" / "sub");
+	fs::remove(temp.dir() / "dir");
+
+	// The parent directory changed too.
+	cache.invalidate(temp.dir() / "dir" / "sub");
+	BOOST_CHECK(!cache.exists(temp.dir() / "dir" / "sub"));
+	BOOST_CHECK(!cache.exists(temp.dir() / "dir"));
+}
+
+BOOST_AUTO_TEST_CASE(relative_paths)
+{
+	TemporaryDirectory temp;
+	StatCache cache;
+	temp.create_file("file");
+	BOOST_CHECK(cache.exists("file"));
+	fs::remove(temp.dir() / "file");
+	BOOST_CHECK(!cache.exists("file"));
+	BOOST_CHECK_EQUAL(cache.hits(), 0u);
+}
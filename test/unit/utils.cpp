@@ -1,6 +1,13 @@
+#include "tools/TemporaryDirectory.hpp"
+
+#include <configure/Filesystem.hpp>
+#include <configure/utils/glob.hpp>
 #include <configure/utils/path.hpp>
+#include <configure/utils/sha256.hpp>
 #include <configure/error.hpp>
 
+#include <algorithm>
+
 namespace fs = boost::filesystem;
 
 BOOST_AUTO_TEST_CASE(path)
@@ -44,3 +51,133 @@ BOOST_AUTO_TEST_CASE(path)
 	    "."
 	);
 }
+
+BOOST_AUTO_TEST_CASE(match_name)
+{
+	using configure::utils::match_name;
+	BOOST_CHECK(match_name("*.cpp", "main.cpp"));
+	BOOST_CHECK(!match_name("*.cpp", "main.hpp"));
+	BOOST_CHECK(match_name("*", "a"));
+	BOOST_CHECK(!match_name("*", ".hidden"));
+	BOOST_CHECK(match_name(".*", ".hidden"));
+	BOOST_CHECK(match_name("a?c", "abc"));
+	BOOST_CHECK(!match_name("a?c", "ac"));
+	BOOST_CHECK(match_name("[a-c]x", "bx"));
+	BOOST_CHECK(!match_name("[!a-c]x", "bx"));
+	BOOST_CHECK(match_name("*a*b*", "xxaxxbxx"));
+	BOOST_CHECK(!match_name("*a*b", "xxaxxbxx"));
+	BOOST_CHECK(match_name("\\*", "*"));
+	BOOST_CHECK(!match_name("\\*", "a"));
+}
+
+BOOST_AUTO_TEST_CASE(glob_pattern)
+{
+	using configure::utils::expand_braces;
+	using configure::utils::GlobPattern;
+	typedef std::vector<std::string> V;
+	BOOST_CHECK(expand_braces("*.{c,cpp}") == (V{"*.c", "*.cpp"}));
+	BOOST_CHECK(expand_braces("{a,b{c,d}}") == (V{"a", "bc", "bd"}));
+	BOOST_CHECK(expand_braces("{a}") == (V{"{a}"}));
+
+	GlobPattern p("*.{c,cpp}");
+	BOOST_CHECK(p.match({"a.c"}));
+	BOOST_CHECK(p.match({"src", "a.cpp"}));
+	BOOST_CHECK(!p.match({"src", "a.h"}));
+
+	GlobPattern anchored("src/**/*.c");
+	BOOST_CHECK(anchored.match({"src", "a.c"}));
+	BOOST_CHECK(anchored.match({"src", "x", "y", "a.c"}));
+	BOOST_CHECK(!anchored.match({"lib", "src", "a.c"}));
+}
+
+BOOST_AUTO_TEST_CASE(rglob)
+{
+	TemporaryDirectory temp;
+	fs::create_directories(temp.dir() / "src" / "sub");
+	fs::create_directories(temp.dir() / "build");
+	temp.create_file("a.cpp");
+	temp.create_file("src/b.cpp");
+	temp.create_file("src/b.hpp");
+	temp.create_file("src/sub/c.cpp");
+	temp.create_file("build/d.cpp");
+
+	std::vector<fs::path> directories;
+	auto res = configure::rglob(temp.dir(), "*.cpp", {"build"}, &directories);
+	BOOST_CHECK(res == (std::vector<fs::path>{
+		temp.dir() / "a.cpp",
+		temp.dir() / "src/b.cpp",
+		temp.dir() / "src/sub/c.cpp",
+	}));
+	BOOST_CHECK(directories == (std::vector<fs::path>{
+		temp.dir() / "src",
+		temp.dir() / "src/sub",
+	}));
+
+	res = configure::rglob(temp.dir(), "src/**/*.{cpp,hpp}");
+	BOOST_CHECK_EQUAL(res.size(), 3u);
+	BOOST_CHECK_THROW(configure::rglob(temp.dir() / "NOT_HERE", "*"),
+	                  std::exception);
+
+	// Without `**`, the pattern matches at any depth.
+	fs::create_directories(temp.dir() / "lib" / "src");
+	temp.create_file("lib/src/e.cpp");
+	res = configure::rglob(temp.dir(), "src/*.cpp");
+	BOOST_CHECK(res == (std::vector<fs::path>{
+		temp.dir() / "lib/src/e.cpp",
+		temp.dir() / "src/b.cpp",
+	}));
+
+#ifndef _WIN32
+	// Links to directories are neither returned nor followed.
+	fs::create_directory_symlink(temp.dir() / "src", temp.dir() / "link");
+	temp.create_file("file");
+	fs::create_symlink(temp.dir() / "file", temp.dir() / "file_link");
+	res = configure::rglob(temp.dir(), "*link*");
+	BOOST_CHECK(res == (std::vector<fs::path>{temp.dir() / "file_link"}));
+	res = configure::rglob(temp.dir(), "link/**/*.cpp");
+	BOOST_CHECK(res.empty());
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(rglob_many_directories)
+{
+	TemporaryDirectory temp;
+	for (int i = 0; i < 100; ++i)
+	{
+		auto dir = "dir" + std::to_string(i);
+		fs::create_directories(temp.dir() / dir / "sub");
+		temp.create_file(dir + "/a.c");
+		temp.create_file(dir + "/sub/b.c");
+	}
+	std::vector<fs::path> directories;
+	auto res = configure::rglob(temp.dir(), "*.c", {}, &directories);
+	BOOST_CHECK_EQUAL(res.size(), 200u);
+	BOOST_CHECK_EQUAL(directories.size(), 200u);
+	BOOST_CHECK(std::is_sorted(res.begin(), res.end()));
+}
+
+BOOST_AUTO_TEST_CASE(sha256)
+{
+	using configure::utils::sha256;
+	BOOST_CHECK_EQUAL(
+		sha256(""),
+		"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+	);
+	BOOST_CHECK_EQUAL(
+		sha256("abc"),
+		"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+	);
+	BOOST_CHECK_EQUAL(
+		sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+		"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+	);
+	// Updated by chunks that are not aligned on blocks.
+	configure::utils::Sha256 hash;
+	std::string a(1000, 'a');
+	for (int i = 0; i < 1000; ++i)
+		hash.update(a.data(), a.size());
+	BOOST_CHECK_EQUAL(
+		hash.hexdigest(),
+		"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"
+	);
+}